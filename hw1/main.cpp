@@ -8,62 +8,1105 @@
 #include <chrono>
 #include <cmath>
 #include <fstream>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <climits>
+#include <map>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 using namespace std;
 
+// Running total and count, kept current by every insert so analytic reads are O(1).
+struct Aggregates {
+  long long total = 0;
+  size_t count = 0;
+  void add(int score) {
+    total += score;
+    ++count;
+  }
+  void add(const pair<int, int>* recs, size_t n) {
+    for (size_t i = 0; i < n; ++i) total += recs[i].second;
+    count += n;
+  }
+  void remove(long long removed_total, size_t n) {
+    total -= removed_total;
+    count -= n;
+  }
+};
+
+// Called once per stored score of the searched id; ctx is passed through untouched.
+typedef void (*ScoreVisitor)(void* ctx, int score);
+// Called once per distinct id with the sum of its scores.
+typedef void (*TotalVisitor)(void* ctx, int id, long long total);
+
 struct BaseDS {
   virtual ~BaseDS() = default;
   virtual void insert(int id, int score) = 0;
-  virtual vector<int> search(int id) const = 0;
-  virtual long long sum_scores() const = 0;
+  // Zero-copy lookup: feeds every score of id to fn and returns how many there were.
+  virtual size_t visit(int id, ScoreVisitor fn, void* ctx) const = 0;
+  // Full traversal of the stored scores; sum_scores() answers from the aggregates instead.
+  virtual long long scan_scores() const = 0;
+  // Bulk ingestion; structures override this when they can do better than n single inserts.
+  virtual void insert_batch(const pair<int, int>* recs, size_t n) {
+    for (size_t i = 0; i < n; ++i) insert(recs[i].first, recs[i].second);
+  }
+  // Drops every score stored under id and returns how many there were.
+  virtual size_t erase(int id) = 0;
+  // Replaces one stored old_score of id with new_score; false if id has no such score.
+  virtual bool update(int id, int old_score, int new_score) = 0;
+  // Concrete structures shadow this with an inline version for templated drivers.
+  template <class F>
+  size_t for_each_score(int id, F& f) const {
+    return visit(id, [](void* ctx, int score) { (*static_cast<F*>(ctx))(score); }, &f);
+  }
+  // Copying lookup kept for callers that want ownership; {-1} on a miss.
+  vector<int> search(int id) const {
+    vector<int> res;
+    visit(id, [](void* ctx, int score) { static_cast<vector<int>*>(ctx)->push_back(score); }, &res);
+    return res.empty() ? vector<int>{-1} : res;
+  }
+  virtual long long sum_scores() const { return agg.total; }
+  virtual size_t count() const { return agg.count; }
+  double mean() const {
+    size_t n = count();
+    return n ? static_cast<double>(sum_scores()) / n : 0.0;
+  }
+  // Every distinct id in [lo, hi] with its score total; order is up to the structure.
+  virtual void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const = 0;
+  // Sum of the scores of ids in [lo, hi]. Structures with a prefix index override the walk.
+  virtual long long range_sum(int lo, int hi) const {
+    long long s = 0;
+    visit_totals(lo, hi, [](void* ctx, int, long long total) { *static_cast<long long*>(ctx) += total; }, &s);
+    return s;
+  }
+  // The k ids with the largest score totals, largest first; ties go to the smaller id.
+  virtual vector<pair<int, long long>> top_k(size_t k) const {
+    struct Ctx {
+      size_t k;
+      vector<pair<int, long long>> heap;  // min-heap on rank_before, worst kept entry on top
+    } c{k, {}};
+    if (k == 0) return {};
+    visit_totals(INT_MIN, INT_MAX, [](void* ctx, int id, long long total) {
+      Ctx& c = *static_cast<Ctx*>(ctx);
+      pair<int, long long> e{id, total};
+      if (c.heap.size() < c.k) {
+        c.heap.push_back(e);
+        push_heap(c.heap.begin(), c.heap.end(), rank_before);
+      } else if (rank_before(e, c.heap.front())) {
+        pop_heap(c.heap.begin(), c.heap.end(), rank_before);
+        c.heap.back() = e;
+        push_heap(c.heap.begin(), c.heap.end(), rank_before);
+      }
+    }, &c);
+    sort_heap(c.heap.begin(), c.heap.end(), rank_before);
+    return c.heap;
+  }
+  // top_k order: larger total first, then smaller id.
+  static bool rank_before(const pair<int, long long>& a, const pair<int, long long>& b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  }
+protected:
+  Aggregates agg;
 };
 
-class DS1 : public BaseDS {
+// Feeds runs of equal ids in [first, last) to fn as (id, total); get(it) yields the (id, score) pair.
+template <class It, class Get>
+void visit_sorted_totals(It first, It last, int hi, Get get, TotalVisitor fn, void* ctx) {
+  while (first != last && get(first).first <= hi) {
+    int id = get(first).first;
+    long long total = 0;
+    for (; first != last && get(first).first == id; ++first) total += get(first).second;
+    fn(ctx, id, total);
+  }
+}
+
+// Whole file mapped read-only; unmapped on destruction.
+class MappedFile {
+  void* base = MAP_FAILED;
+  size_t len = 0;
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (base != MAP_FAILED) munmap(base, len);
+  }
+  const char* data() const { return static_cast<const char*>(base); }
+  size_t size() const { return len; }
+  bool open(const string& path, string& err) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      err = "cannot open " + path;
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      err = path + ": empty or unreadable";
+      return false;
+    }
+    len = st.st_size;
+    base = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      err = "mmap failed for " + path;
+      return false;
+    }
+    return true;
+  }
+  void advise(int advice) const {
+    if (base != MAP_FAILED) madvise(base, len, advice);
+  }
+};
+
+// Word-at-a-time FNV-style hash, cheap enough to run over every snapshot record.
+inline uint64_t checksum64(const void* p, size_t bytes) {
+  const unsigned char* b = static_cast<const unsigned char*>(p);
+  uint64_t h = 1469598103934665603ull;
+  size_t i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t w;
+    memcpy(&w, b + i, 8);
+    h = (h ^ w) * 1099511628211ull;
+  }
+  for (; i < bytes; ++i) h = (h ^ b[i]) * 1099511628211ull;
+  return h;
+}
+
+// Erase only tombstones records, so nothing shifts; the dead ones are dropped in one
+// pass once they pass COMPACT_DEAD_PCT of data.
+class DS1 final : public BaseDS {
+  static const size_t COMPACT_DEAD_PCT = 25;
   vector<pair<int, int>> data;
+  vector<uint64_t> dead;        // tombstone bitmap over data; all zero while n_dead == 0
+  size_t n_dead = 0;
+  // prefix[i] = sum of live scores in the first i records, valid for i <= prefix_valid.
+  // Writes only lower the mark; range_sum extends it, so write-heavy phases pay nothing.
+  mutable vector<long long> prefix{0};
+  mutable size_t prefix_valid = 0;
+  mutable mutex prefix_mu;  // range_sum can run concurrently under ShardedDS's shared lock
+  // Set while serving straight from an opened snapshot; the first insert copies it into data.
+  unique_ptr<MappedFile> snap;
+  const pair<int, int>* snap_recs = nullptr;
+  size_t snap_n = 0;
+
+  const pair<int, int>* recs_begin() const { return snap ? snap_recs : data.data(); }
+  const pair<int, int>* recs_end() const { return snap ? snap_recs + snap_n : data.data() + data.size(); }
+  void materialize() {
+    if (!snap) return;
+    data.assign(snap_recs, snap_recs + snap_n);
+    snap.reset();
+    snap_recs = nullptr;
+    snap_n = 0;
+  }
+  void invalidate_prefix(size_t pos) { prefix_valid = min(prefix_valid, pos); }
+  // Caller holds prefix_mu.
+  long long prefix_at(size_t n) const {
+    if (n > prefix_valid) {
+      const pair<int, int>* r = recs_begin();
+      if (prefix.size() < n + 1) prefix.resize(recs_end() - r + 1);
+      for (size_t i = prefix_valid; i < n; ++i) prefix[i + 1] = prefix[i] + (is_dead(i) ? 0 : r[i].second);
+      prefix_valid = n;
+    }
+    return prefix[n];
+  }
+  const pair<int, int>* lower(int id) const {
+    return lower_bound(recs_begin(), recs_end(), id, [](const pair<int, int>& p, int i) { return p.first < i; });
+  }
+  bool is_dead(size_t i) const { return n_dead && ((dead[i >> 6] >> (i & 63)) & 1); }
+  // Opens a live bit at pos to match a record inserted there.
+  void insert_dead_bit(size_t pos) {
+    if (!n_dead) return;
+    dead.resize((data.size() + 63) / 64, 0);
+    size_t w = pos >> 6;
+    for (size_t k = dead.size() - 1; k > w; --k) dead[k] = (dead[k] << 1) | (dead[k - 1] >> 63);
+    uint64_t low = (1ull << (pos & 63)) - 1;
+    dead[w] = (dead[w] & low) | ((dead[w] & ~low) << 1);
+  }
+  // Drops tombstoned records in one pass.
+  void compact() {
+    if (!n_dead) return;
+    size_t w = 0;
+    for (size_t i = 0; i < data.size(); ++i)
+      if (!is_dead(i)) data[w++] = data[i];
+    data.resize(w);
+    n_dead = 0;
+    dead.clear();
+    invalidate_prefix(0);
+  }
 public:
+  // Snapshot file: SnapshotHeader followed by count sorted (id, score) int32 pairs.
+  struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    int64_t total;
+    uint64_t checksum;  // checksum64 over the records
+  };
+  static const uint32_t SNAPSHOT_VERSION = 1;
+
   DS1() { data.reserve(1); }
   void insert(int id, int score) override {
+    materialize();
     if (data.size() == data.capacity()) {
       size_t new_cap = data.capacity() * 10;
       if (new_cap < 1) new_cap = 1;
       data.reserve(new_cap);
     }
     auto it = lower_bound(data.begin(), data.end(), id, [](const pair<int, int>& p, int i) { return p.first < i; });
+    size_t pos = it - data.begin();
     data.insert(it, {id, score});
+    insert_dead_bit(pos);
+    invalidate_prefix(pos);
+    agg.add(score);
   }
-  vector<int> search(int id) const override {
-    auto lit = lower_bound(data.begin(), data.end(), id, [](const pair<int, int>& p, int i) { return p.first < i; });
-    auto uit = upper_bound(lit, data.end(), id, [](int i, const pair<int, int>& p) { return i < p.first; });
-    vector<int> res;
-    for (auto it = lit; it != uit; ++it) res.push_back(it->second);
-    return res.empty() ? vector<int>{-1} : res;
+  // Sort the batch, then merge it into data from the back in one linear pass.
+  void insert_batch(const pair<int, int>* recs, size_t n) override {
+    if (n == 0) return;
+    materialize();
+    compact();
+    agg.add(recs, n);
+    vector<pair<int, int>> batch(recs, recs + n);
+    stable_sort(batch.begin(), batch.end(), [](const pair<int, int>& a, const pair<int, int>& b) { return a.first < b.first; });
+    size_t old_n = data.size();
+    data.resize(old_n + n);
+    size_t i = old_n, j = n, k = old_n + n;
+    while (j > 0) {
+      if (i > 0 && data[i - 1].first > batch[j - 1].first) data[--k] = data[--i];
+      else data[--k] = batch[--j];
+    }
+    invalidate_prefix(k);
   }
-  long long sum_scores() const override {
+  size_t erase(int id) override {
+    materialize();
+    dead.resize((data.size() + 63) / 64, 0);
+    long long removed = 0;
+    size_t n = 0, first = lower(id) - data.data();
+    for (size_t i = first; i < data.size() && data[i].first == id; ++i) {
+      if (is_dead(i)) continue;
+      dead[i >> 6] |= 1ull << (i & 63);
+      removed += data[i].second;
+      ++n;
+    }
+    n_dead += n;
+    invalidate_prefix(first);
+    agg.remove(removed, n);
+    if (n_dead * 100 > data.size() * COMPACT_DEAD_PCT) compact();
+    return n;
+  }
+  bool update(int id, int old_score, int new_score) override {
+    materialize();
+    for (size_t i = lower(id) - data.data(); i < data.size() && data[i].first == id; ++i) {
+      if (is_dead(i) || data[i].second != old_score) continue;
+      data[i].second = new_score;
+      invalidate_prefix(i);
+      agg.total += static_cast<long long>(new_score) - old_score;
+      return true;
+    }
+    return false;
+  }
+  template <class F>
+  size_t for_each_score(int id, F& f) const {
+    const pair<int, int>* b = recs_begin();
+    size_t i = lower(id) - b, n = recs_end() - b, live = 0;
+    for (; i < n && b[i].first == id; ++i) {
+      if (is_dead(i)) continue;
+      f(b[i].second);
+      ++live;
+    }
+    return live;
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    auto call = [fn, ctx](int score) { fn(ctx, score); };
+    return for_each_score(id, call);
+  }
+  long long scan_scores() const override {
     long long s = 0;
-    for (const auto& p : data) s += p.second;
+    if (!n_dead) {
+      for (auto it = recs_begin(); it != recs_end(); ++it) s += it->second;
+      return s;
+    }
+    for (size_t i = 0; i < data.size(); ++i)
+      if (!is_dead(i)) s += data[i].second;
     return s;
   }
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override {
+    if (!n_dead) {
+      visit_sorted_totals(lower(lo), recs_end(), hi, [](const pair<int, int>* p) { return *p; }, fn, ctx);
+      return;
+    }
+    for (size_t i = lower(lo) - data.data(); i < data.size() && data[i].first <= hi;) {
+      int id = data[i].first;
+      long long total = 0;
+      bool live = false;
+      for (; i < data.size() && data[i].first == id; ++i) {
+        if (is_dead(i)) continue;
+        total += data[i].second;
+        live = true;
+      }
+      if (live) fn(ctx, id, total);
+    }
+  }
+  // Two binary searches and a prefix difference, once the prefix has caught up with the writes.
+  long long range_sum(int lo, int hi) const override {
+    if (lo > hi) return 0;
+    size_t a = lower(lo) - recs_begin();
+    size_t b = (hi == INT_MAX ? recs_end() : lower(hi + 1)) - recs_begin();
+    lock_guard<mutex> lk(prefix_mu);
+    return prefix_at(b) - prefix_at(a);
+  }
+  // Tombstoned records are left out of the file.
+  bool save_snapshot(const string& path, string& err) const {
+    const pair<int, int>* recs = recs_begin();
+    size_t n = recs_end() - recs;
+    vector<pair<int, int>> live;
+    if (n_dead) {
+      live.reserve(n - n_dead);
+      for (size_t i = 0; i < n; ++i)
+        if (!is_dead(i)) live.push_back(recs[i]);
+      recs = live.data();
+      n = live.size();
+    }
+    SnapshotHeader h;
+    memcpy(h.magic, "DS1SNAP", 8);
+    h.version = SNAPSHOT_VERSION;
+    h.record_size = sizeof(pair<int, int>);
+    h.count = n;
+    h.total = agg.total;
+    h.checksum = checksum64(recs, n * sizeof(pair<int, int>));
+    ofstream f(path, ios::binary);
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    f.write(reinterpret_cast<const char*>(recs), n * sizeof(pair<int, int>));
+    if (!f) {
+      err = "failed to write " + path;
+      return false;
+    }
+    return true;
+  }
+  // Replaces the contents with a snapshot mapped read-only. Only the header is checked
+  // unless verify is set, so opening costs O(1) regardless of the record count.
+  bool open_snapshot(const string& path, string& err, bool verify = false) {
+    unique_ptr<MappedFile> m(new MappedFile());
+    if (!m->open(path, err)) return false;
+    if (m->size() < sizeof(SnapshotHeader)) {
+      err = path + ": too short for a snapshot header";
+      return false;
+    }
+    SnapshotHeader h;
+    memcpy(&h, m->data(), sizeof(h));
+    if (memcmp(h.magic, "DS1SNAP", 8) != 0 || h.version != SNAPSHOT_VERSION || h.record_size != sizeof(pair<int, int>)) {
+      err = path + ": not a version " + to_string(SNAPSHOT_VERSION) + " DS1 snapshot";
+      return false;
+    }
+    if (h.count != (m->size() - sizeof(SnapshotHeader)) / sizeof(pair<int, int>)) {
+      err = path + ": size does not match record count " + to_string(h.count);
+      return false;
+    }
+    const pair<int, int>* recs = reinterpret_cast<const pair<int, int>*>(m->data() + sizeof(SnapshotHeader));
+    if (verify && checksum64(recs, h.count * sizeof(pair<int, int>)) != h.checksum) {
+      err = path + ": checksum mismatch";
+      return false;
+    }
+    m->advise(MADV_RANDOM);
+    vector<pair<int, int>>().swap(data);
+    prefix_valid = 0;
+    dead.clear();
+    n_dead = 0;
+    snap = move(m);
+    snap_recs = recs;
+    snap_n = h.count;
+    agg.total = h.total;
+    agg.count = h.count;
+    return true;
+  }
 };
+const uint32_t DS1::SNAPSHOT_VERSION;
+const size_t DS1::COMPACT_DEAD_PCT;
+
+// DS1 with an LSM-style write path: inserts land in a small unsorted buffer that is
+// flushed to immutable sorted runs. Runs are size-tiered: FANOUT runs of one tier merge
+// into a single run of the next, so each record is rewritten O(log n) times in total.
+class DS1Lsm final : public BaseDS {
+  struct Run {
+    vector<pair<int, int>> recs;
+    vector<int> fence;  // recs[b * FENCE_EVERY].first for every block b; empty when disabled
+  };
+  static const size_t BUFFER_CAP = 256;
+  static const size_t FANOUT = 4;
+  static const size_t FENCE_EVERY = 64;
 
-class DS2 : public BaseDS {
-  static const int MAX_ID = 1 << 20;
-  vector<list<int>> array;
+  vector<pair<int, int>> buffer;
+  vector<vector<Run>> tiers;  // tiers[t] holds runs of about BUFFER_CAP * FANOUT^t records
+  bool use_fences;
+
+  static bool id_less(const pair<int, int>& a, const pair<int, int>& b) { return a.first < b.first; }
+
+  Run make_run(vector<pair<int, int>>&& recs) const {
+    Run r;
+    r.recs = move(recs);
+    set_fences(r);
+    return r;
+  }
+  void set_fences(Run& r) const {
+    r.fence.clear();
+    if (!use_fences) return;
+    r.fence.reserve(r.recs.size() / FENCE_EVERY + 1);
+    for (size_t i = 0; i < r.recs.size(); i += FENCE_EVERY) r.fence.push_back(r.recs[i].first);
+  }
+  // First position in r with id >= key: fences narrow the search to one block.
+  size_t run_lower(const Run& r, int id) const {
+    size_t lo = 0, hi = r.recs.size();
+    if (!r.fence.empty()) {
+      size_t b = lower_bound(r.fence.begin(), r.fence.end(), id) - r.fence.begin();
+      if (b > 0) --b;
+      lo = b * FENCE_EVERY;
+      hi = min(hi, lo + FENCE_EVERY);
+    }
+    return lower_bound(r.recs.begin() + lo, r.recs.begin() + hi, id, [](const pair<int, int>& p, int i) { return p.first < i; }) - r.recs.begin();
+  }
+  static vector<pair<int, int>> merge_runs(vector<Run>& runs) {
+    vector<pair<int, int>> out = move(runs[0].recs), tmp;
+    for (size_t i = 1; i < runs.size(); ++i) {
+      tmp.resize(out.size() + runs[i].recs.size());
+      merge(out.begin(), out.end(), runs[i].recs.begin(), runs[i].recs.end(), tmp.begin(), id_less);
+      out.swap(tmp);
+    }
+    runs.clear();
+    return out;
+  }
+  // Adds a sorted run at tier t and merges full tiers upward.
+  void add_run(vector<pair<int, int>>&& recs, size_t t) {
+    if (tiers.size() <= t) tiers.resize(t + 1);
+    tiers[t].push_back(make_run(move(recs)));
+    for (; t < tiers.size() && tiers[t].size() >= FANOUT; ++t) {
+      vector<pair<int, int>> merged = merge_runs(tiers[t]);
+      if (tiers.size() <= t + 1) tiers.resize(t + 2);
+      tiers[t + 1].push_back(make_run(move(merged)));
+    }
+  }
+  static size_t tier_for(size_t n) {
+    size_t t = 0;
+    for (size_t cap = BUFFER_CAP; n > cap; cap *= FANOUT) ++t;
+    return t;
+  }
+  void flush() {
+    if (buffer.empty()) return;
+    vector<pair<int, int>> recs;
+    recs.swap(buffer);
+    buffer.reserve(BUFFER_CAP);
+    stable_sort(recs.begin(), recs.end(), id_less);
+    add_run(move(recs), 0);
+  }
 public:
-  DS2() : array(MAX_ID + 1) {}
+  explicit DS1Lsm(bool fences = true) : use_fences(fences) { buffer.reserve(BUFFER_CAP); }
   void insert(int id, int score) override {
-    array[id].push_back(score);
+    buffer.push_back({id, score});
+    agg.add(score);
+    if (buffer.size() >= BUFFER_CAP) flush();
   }
-  vector<int> search(int id) const override {
-    const auto& l = array[id];
-    return l.empty() ? vector<int>{-1} : vector<int>(l.begin(), l.end());
+  void insert_batch(const pair<int, int>* recs, size_t n) override {
+    if (n == 0) return;
+    agg.add(recs, n);
+    flush();
+    vector<pair<int, int>> batch(recs, recs + n);
+    stable_sort(batch.begin(), batch.end(), id_less);
+    add_run(move(batch), tier_for(n));
   }
-  long long sum_scores() const override {
+  // Cuts the id out of the buffer and of every run that holds it; emptied runs are dropped.
+  size_t erase(int id) override {
+    long long removed = 0;
+    size_t n = 0;
+    auto dead = [&](const pair<int, int>& p) {
+      if (p.first != id) return false;
+      removed += p.second;
+      ++n;
+      return true;
+    };
+    buffer.erase(remove_if(buffer.begin(), buffer.end(), dead), buffer.end());
+    for (auto& tier : tiers) {
+      for (Run& r : tier) {
+        if (r.recs.empty() || id < r.recs.front().first || id > r.recs.back().first) continue;
+        auto first = r.recs.begin() + run_lower(r, id), last = first;
+        while (last != r.recs.end() && dead(*last)) ++last;
+        if (first == last) continue;
+        r.recs.erase(first, last);
+        set_fences(r);
+      }
+      tier.erase(remove_if(tier.begin(), tier.end(), [](const Run& r) { return r.recs.empty(); }), tier.end());
+    }
+    agg.remove(removed, n);
+    return n;
+  }
+  bool update(int id, int old_score, int new_score) override {
+    auto hit = [&](pair<int, int>& p) {
+      if (p.first != id || p.second != old_score) return false;
+      p.second = new_score;
+      agg.total += static_cast<long long>(new_score) - old_score;
+      return true;
+    };
+    for (auto& p : buffer)
+      if (hit(p)) return true;
+    for (auto& tier : tiers)
+      for (Run& r : tier) {
+        if (r.recs.empty() || id < r.recs.front().first || id > r.recs.back().first) continue;
+        for (size_t i = run_lower(r, id); i < r.recs.size() && r.recs[i].first == id; ++i)
+          if (hit(r.recs[i])) return true;
+      }
+    return false;
+  }
+  // Merges the buffer and every run into one, so later searches probe a single array.
+  void compact() {
+    flush();
+    vector<Run> all;
+    for (auto& tier : tiers)
+      for (auto& r : tier) all.push_back(move(r));
+    tiers.clear();
+    if (all.empty()) return;
+    vector<pair<int, int>> merged = merge_runs(all);
+    size_t t = tier_for(merged.size());
+    tiers.resize(t + 1);
+    tiers[t].push_back(make_run(move(merged)));
+  }
+  size_t run_count() const {
+    size_t n = 0;
+    for (const auto& tier : tiers) n += tier.size();
+    return n;
+  }
+  template <class F>
+  size_t for_each_score(int id, F& f) const {
+    size_t n = 0;
+    for (const auto& p : buffer)
+      if (p.first == id) {
+        f(p.second);
+        ++n;
+      }
+    for (const auto& tier : tiers)
+      for (const Run& r : tier) {
+        if (r.recs.empty() || id < r.recs.front().first || id > r.recs.back().first) continue;
+        for (size_t i = run_lower(r, id); i < r.recs.size() && r.recs[i].first == id; ++i, ++n) f(r.recs[i].second);
+      }
+    return n;
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    auto call = [fn, ctx](int score) { fn(ctx, score); };
+    return for_each_score(id, call);
+  }
+  long long scan_scores() const override {
+    long long s = 0;
+    for (const auto& p : buffer) s += p.second;
+    for (const auto& tier : tiers)
+      for (const Run& r : tier)
+        for (const auto& p : r.recs) s += p.second;
+    return s;
+  }
+  // An id can be spread over several runs, so the matching records are gathered and sorted first.
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override {
+    if (lo > hi) return;
+    vector<pair<int, int>> hits;
+    for (const auto& p : buffer)
+      if (p.first >= lo && p.first <= hi) hits.push_back(p);
+    for (const auto& tier : tiers)
+      for (const Run& r : tier)
+        for (size_t i = run_lower(r, lo); i < r.recs.size() && r.recs[i].first <= hi; ++i) hits.push_back(r.recs[i]);
+    sort(hits.begin(), hits.end(), id_less);
+    visit_sorted_totals(hits.cbegin(), hits.cend(), hi, [](vector<pair<int, int>>::const_iterator it) { return *it; }, fn, ctx);
+  }
+};
+const size_t DS1Lsm::BUFFER_CAP;
+const size_t DS1Lsm::FANOUT;
+const size_t DS1Lsm::FENCE_EVERY;
+
+// DS1 with ids and scores in separate arrays: search touches only ids, scans only scores.
+class DS1SoA final : public BaseDS {
+  vector<int> ids;
+  vector<int> scores;
+  // Branchless lower_bound over ids: the loop trip count depends only on size.
+  size_t lower(int id) const {
+    const int* base = ids.data();
+    size_t len = ids.size();
+    if (len == 0) return 0;
+    while (len > 1) {
+      size_t half = len / 2;
+      base = (base[half - 1] < id) ? base + half : base;
+      len -= half;
+    }
+    return (base - ids.data()) + (*base < id);
+  }
+public:
+  void insert(int id, int score) override {
+    size_t pos = lower(id);
+    ids.insert(ids.begin() + pos, id);
+    scores.insert(scores.begin() + pos, score);
+    agg.add(score);
+  }
+  void insert_batch(const pair<int, int>* recs, size_t n) override {
+    if (n == 0) return;
+    agg.add(recs, n);
+    vector<pair<int, int>> batch(recs, recs + n);
+    stable_sort(batch.begin(), batch.end(), [](const pair<int, int>& a, const pair<int, int>& b) { return a.first < b.first; });
+    size_t old_n = ids.size();
+    ids.resize(old_n + n);
+    scores.resize(old_n + n);
+    size_t i = old_n, j = n, k = old_n + n;
+    while (j > 0) {
+      --k;
+      if (i > 0 && ids[i - 1] > batch[j - 1].first) {
+        --i;
+        ids[k] = ids[i];
+        scores[k] = scores[i];
+      } else {
+        --j;
+        ids[k] = batch[j].first;
+        scores[k] = batch[j].second;
+      }
+    }
+  }
+  size_t erase(int id) override {
+    size_t first = lower(id), last = first;
+    long long removed = 0;
+    for (; last < ids.size() && ids[last] == id; ++last) removed += scores[last];
+    ids.erase(ids.begin() + first, ids.begin() + last);
+    scores.erase(scores.begin() + first, scores.begin() + last);
+    agg.remove(removed, last - first);
+    return last - first;
+  }
+  bool update(int id, int old_score, int new_score) override {
+    for (size_t i = lower(id); i < ids.size() && ids[i] == id; ++i) {
+      if (scores[i] != old_score) continue;
+      scores[i] = new_score;
+      agg.total += static_cast<long long>(new_score) - old_score;
+      return true;
+    }
+    return false;
+  }
+  template <class F>
+  size_t for_each_score(int id, F& f) const {
+    size_t first = lower(id), i = first;
+    for (; i < ids.size() && ids[i] == id; ++i) f(scores[i]);
+    return i - first;
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    auto call = [fn, ctx](int score) { fn(ctx, score); };
+    return for_each_score(id, call);
+  }
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override {
+    visit_sorted_totals(lower(lo), ids.size(), hi, [this](size_t i) { return make_pair(ids[i], scores[i]); }, fn, ctx);
+  }
+  long long scan_scores() const override {
+    const int* p = scores.data();
+    size_t n = scores.size(), i = 0;
+    long long s = 0;
+#if defined(__AVX2__)
+    // Sign-extend 4 ints to 64-bit lanes per step, two accumulators to hide add latency.
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+      acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(p + i))));
+      acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(p + i + 4))));
+    }
+    alignas(32) long long lanes[4];
+    _mm256_store_si256((__m256i*)lanes, _mm256_add_epi64(acc0, acc1));
+    s = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+      __m128i sign = _mm_srai_epi32(v, 31);
+      acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+      acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+    }
+    alignas(16) long long lanes[2];
+    _mm_store_si128((__m128i*)lanes, acc);
+    s = lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i) s += p[i];
+    return s;
+  }
+};
+
+// Two-level map from a 32-bit id to V, Roaring-style: the high 16 bits pick a block
+// and the low 16 bits locate the id inside it. A block is absent, sparse or dense
+// (all 65536 values plus a presence bitmap), and switches form as it fills or drains,
+// so memory follows the ids actually in use. A sparse block keeps its values unsorted
+// in arrival order behind a sorted array of (low key, slot) words, so a new id shifts
+// 4-byte words instead of whole values.
+template <class V>
+class IdDirectory {
+  static const size_t BLOCK = 1 << 16;
+  static const size_t PROMOTE_AT = 4096;  // sparse -> dense once a block holds more ids
+  static const size_t DEMOTE_AT = 2048;   // dense -> sparse once it drops below
+  struct Block {
+    bool dense = false;
+    size_t used = 0;
+    vector<uint32_t> keys;     // sparse only: low key << 16 | slot in vals, sorted by key
+    vector<V> vals;            // sparse: indexed by slot; dense: indexed by low bits
+    vector<uint64_t> present;  // dense only
+    bool has(uint16_t lo) const { return (present[lo >> 6] >> (lo & 63)) & 1; }
+    // First sparse key word whose low key is >= lo.
+    vector<uint32_t>::const_iterator lower(size_t lo) const {
+      return lower_bound(keys.begin(), keys.end(), static_cast<uint32_t>(lo << 16));
+    }
+  };
+  vector<unique_ptr<Block>> blocks;  // indexed by high bits, grown on demand
+  size_t n_ids = 0;
+
+  static uint16_t key_of(uint32_t k) { return static_cast<uint16_t>(k >> 16); }
+  static uint16_t slot_of(uint32_t k) { return static_cast<uint16_t>(k); }
+  static void promote(Block& b) {
+    vector<V> vals(BLOCK);
+    b.present.assign(BLOCK / 64, 0);
+    for (uint32_t k : b.keys) {
+      vals[key_of(k)] = move(b.vals[slot_of(k)]);
+      b.present[key_of(k) >> 6] |= 1ull << (key_of(k) & 63);
+    }
+    b.vals.swap(vals);
+    vector<uint32_t>().swap(b.keys);
+    b.dense = true;
+  }
+  static void demote(Block& b) {
+    vector<uint32_t> keys;
+    vector<V> vals;
+    keys.reserve(b.used);
+    vals.reserve(b.used);
+    for (size_t lo = 0; lo < BLOCK; ++lo) {
+      if (!b.has(static_cast<uint16_t>(lo))) continue;
+      keys.push_back(static_cast<uint32_t>(lo << 16 | vals.size()));
+      vals.push_back(move(b.vals[lo]));
+    }
+    b.keys.swap(keys);
+    b.vals.swap(vals);
+    vector<uint64_t>().swap(b.present);
+    b.dense = false;
+  }
+public:
+  size_t size() const { return n_ids; }
+  V* find(uint32_t id) {
+    return const_cast<V*>(static_cast<const IdDirectory*>(this)->find(id));
+  }
+  const V* find(uint32_t id) const {
+    uint32_t hi = id >> 16;
+    uint16_t lo = static_cast<uint16_t>(id);
+    if (hi >= blocks.size() || !blocks[hi]) return nullptr;
+    const Block& b = *blocks[hi];
+    if (b.dense) return b.has(lo) ? &b.vals[lo] : nullptr;
+    auto it = b.lower(lo);
+    return (it != b.keys.end() && key_of(*it) == lo) ? &b.vals[slot_of(*it)] : nullptr;
+  }
+  // Returns the value for id, default-constructing it if the id is new.
+  V& get_or_add(uint32_t id) {
+    uint32_t hi = id >> 16;
+    uint16_t lo = static_cast<uint16_t>(id);
+    if (hi >= blocks.size()) blocks.resize(hi + 1);
+    if (!blocks[hi]) blocks[hi].reset(new Block());
+    Block& b = *blocks[hi];
+    if (b.dense) {
+      if (!b.has(lo)) {
+        b.present[lo >> 6] |= 1ull << (lo & 63);
+        b.vals[lo] = V();
+        ++b.used;
+        ++n_ids;
+      }
+      return b.vals[lo];
+    }
+    auto it = b.lower(lo);
+    if (it != b.keys.end() && key_of(*it) == lo) return b.vals[slot_of(*it)];
+    b.keys.insert(it, static_cast<uint32_t>(lo) << 16 | static_cast<uint32_t>(b.vals.size()));
+    b.vals.emplace_back();
+    ++b.used;
+    ++n_ids;
+    if (b.used > PROMOTE_AT) {
+      promote(b);
+      return b.vals[lo];
+    }
+    return b.vals.back();
+  }
+  bool erase(uint32_t id) {
+    uint32_t hi = id >> 16;
+    uint16_t lo = static_cast<uint16_t>(id);
+    if (hi >= blocks.size() || !blocks[hi]) return false;
+    Block& b = *blocks[hi];
+    if (b.dense) {
+      if (!b.has(lo)) return false;
+      b.present[lo >> 6] &= ~(1ull << (lo & 63));
+      b.vals[lo] = V();
+    } else {
+      auto it = b.lower(lo);
+      if (it == b.keys.end() || key_of(*it) != lo) return false;
+      // Move the last value into the freed slot and repoint its key word.
+      uint16_t slot = slot_of(*it), last = static_cast<uint16_t>(b.vals.size() - 1);
+      b.keys.erase(it);
+      if (slot != last) {
+        b.vals[slot] = move(b.vals[last]);
+        for (uint32_t& k : b.keys) {
+          if (slot_of(k) != last) continue;
+          k = (k & 0xffff0000u) | slot;
+          break;
+        }
+      }
+      b.vals.pop_back();
+    }
+    --b.used;
+    --n_ids;
+    if (b.used == 0) blocks[hi].reset();
+    else if (b.dense && b.used < DEMOTE_AT) demote(b);
+    return true;
+  }
+  // Calls f(id, value) for every id in [lo, hi], in increasing id order.
+  template <class F>
+  void for_each_in(uint32_t lo, uint32_t hi, F f) const {
+    if (lo > hi) return;
+    for (size_t h = lo >> 16; h <= (hi >> 16) && h < blocks.size(); ++h) {
+      if (!blocks[h]) continue;
+      const Block& b = *blocks[h];
+      uint32_t base = static_cast<uint32_t>(h) << 16;
+      size_t from = (h == (lo >> 16)) ? (lo & 0xffff) : 0;
+      size_t to = (h == (hi >> 16)) ? (hi & 0xffff) : BLOCK - 1;
+      if (b.dense) {
+        for (size_t x = from; x <= to; ++x)
+          if (b.has(static_cast<uint16_t>(x))) f(base | static_cast<uint32_t>(x), b.vals[x]);
+      } else {
+        for (auto it = b.lower(from); it != b.keys.end() && key_of(*it) <= to; ++it)
+          f(base | key_of(*it), b.vals[slot_of(*it)]);
+      }
+    }
+  }
+};
+
+// Per-id scores live in fixed-size chunks carved from one shared pool. Unused
+// slots stay zero, so scan_scores is a straight scan of the pool. Any 32-bit id works;
+// the per-id directory is an IdDirectory whose entries also keep the id's running total.
+// range_sum takes whole 65536-id directory blocks from a Fenwick tree over block totals,
+// whole 64-id spans of the two end blocks from a per-block Fenwick tree over span totals
+// (8 KB per block in use), and walks the entries of at most four partial spans.
+class DS2 final : public BaseDS {
+  static const int CHUNK = 8;
+  static const uint32_t NONE = 0xffffffffu;
+  static const int SPAN_BITS = 6;
+  static const int SPANS = 1 << (16 - SPAN_BITS);  // per directory block
+  static const size_t RADIX_MIN = 1 << 16;  // smaller batches use stable_sort
+  struct Entry {
+    uint32_t first = NONE;
+    uint32_t last = NONE;
+    uint32_t count = 0;
+    long long total = 0;
+  };
+  IdDirectory<Entry> dir;
+  vector<int> pool;         // CHUNK scores per chunk
+  vector<uint32_t> next;    // next chunk of the same id
+  vector<long long> block_fen{0, 0};  // Fenwick tree over block totals (id >> 16); size - 1 is a power of two
+  vector<unique_ptr<long long[]>> span_fen;  // per directory block: 1-based Fenwick tree over its SPANS span totals
+  vector<uint32_t> free_chunks;  // released by erase, zeroed, reused by insert
+
+  // Doubling a power-of-two Fenwick tree only adds a new root holding the old total.
+  void add_total(Entry& e, int id, long long delta) {
+    e.total += delta;
+    uint32_t uid = static_cast<uint32_t>(id);
+    size_t b = uid >> 16;
+    if (b >= span_fen.size()) span_fen.resize(b + 1);
+    if (!span_fen[b]) span_fen[b].reset(new long long[SPANS + 1]());
+    long long* f = span_fen[b].get();
+    for (size_t i = ((uid >> SPAN_BITS) & (SPANS - 1)) + 1; i <= SPANS; i += i & (~i + 1)) f[i] += delta;
+    while (b >= block_fen.size() - 1) {
+      size_t cap = block_fen.size() - 1;
+      block_fen.resize(2 * cap + 1, 0);
+      block_fen[2 * cap] = block_fen[cap];
+    }
+    for (size_t i = b + 1; i < block_fen.size(); i += i & (~i + 1)) block_fen[i] += delta;
+  }
+  // Sum of the totals of blocks [0, b).
+  long long blocks_prefix(size_t b) const {
+    long long s = 0;
+    for (size_t i = min(b, block_fen.size() - 1); i > 0; i &= i - 1) s += block_fen[i];
+    return s;
+  }
+  // Sum over ids [lo, hi] within one directory block.
+  long long block_sum(uint32_t lo, uint32_t hi) const {
+    size_t b = lo >> 16;
+    if (b >= span_fen.size() || !span_fen[b]) return 0;
+    long long s = 0;
+    auto add = [&s](uint32_t, const Entry& e) { s += e.total; };
+    uint32_t slo = lo >> SPAN_BITS, shi = hi >> SPAN_BITS;
+    if (slo == shi) {
+      dir.for_each_in(lo, hi, add);
+      return s;
+    }
+    dir.for_each_in(lo, ((slo + 1) << SPAN_BITS) - 1, add);
+    dir.for_each_in(shi << SPAN_BITS, hi, add);
+    // Spans strictly between slo and shi: Fenwick prefix [0, shi) minus [0, slo + 1).
+    const long long* f = span_fen[b].get();
+    for (size_t i = shi & (SPANS - 1); i > 0; i &= i - 1) s += f[i];
+    for (size_t i = ((slo + 1) & (SPANS - 1)); i > 0; i &= i - 1) s -= f[i];
+    return s;
+  }
+  // Sum over ids [lo, hi] in unsigned order.
+  long long sum_unsigned(uint32_t lo, uint32_t hi) const {
+    size_t blo = lo >> 16, bhi = hi >> 16;
+    if (blo == bhi) return block_sum(lo, hi);
+    return block_sum(lo, lo | 0xffff) + block_sum(hi & ~0xffffu, hi) + blocks_prefix(bhi) - blocks_prefix(blo + 1);
+  }
+  // Stable sort on the unsigned id: two 16-bit counting passes for large batches,
+  // where stable_sort's n log n comparisons cost more than the batch insert itself.
+  static void sort_by_id(vector<pair<int, int>>& v) {
+    if (v.size() < RADIX_MIN) {
+      stable_sort(v.begin(), v.end(), [](const pair<int, int>& a, const pair<int, int>& b) {
+        return static_cast<uint32_t>(a.first) < static_cast<uint32_t>(b.first);
+      });
+      return;
+    }
+    vector<pair<int, int>> tmp(v.size());
+    vector<size_t> start(1 << 16);
+    for (int shift = 0; shift < 32; shift += 16) {
+      auto digit = [shift](const pair<int, int>& r) { return (static_cast<uint32_t>(r.first) >> shift) & 0xffff; };
+      fill(start.begin(), start.end(), 0);
+      for (const auto& r : v) ++start[digit(r)];
+      size_t pos = 0;
+      for (size_t& c : start) {
+        size_t cnt = c;
+        c = pos;
+        pos += cnt;
+      }
+      for (const auto& r : v) tmp[start[digit(r)]++] = r;
+      v.swap(tmp);
+    }
+  }
+  // Appends score to e's chunk list, opening a chunk when the last one is full.
+  void append(Entry& e, int score) {
+    if (e.count % CHUNK == 0) {
+      uint32_t c;
+      if (!free_chunks.empty()) {
+        c = free_chunks.back();
+        free_chunks.pop_back();
+        next[c] = NONE;
+      } else {
+        c = static_cast<uint32_t>(next.size());
+        pool.resize(pool.size() + CHUNK, 0);
+        next.push_back(NONE);
+      }
+      if (e.last == NONE) e.first = c;
+      else next[e.last] = c;
+      e.last = c;
+    }
+    pool[static_cast<size_t>(e.last) * CHUNK + e.count % CHUNK] = score;
+    ++e.count;
+  }
+  template <class F>
+  void walk(const Entry& e, F& f) const {
+    uint32_t left = e.count;
+    for (uint32_t c = e.first; c != NONE; c = next[c]) {
+      uint32_t take = min<uint32_t>(left, CHUNK);
+      const int* p = pool.data() + static_cast<size_t>(c) * CHUNK;
+      for (uint32_t i = 0; i < take; ++i) f(p[i]);
+      left -= take;
+    }
+  }
+public:
+  void insert(int id, int score) override {
+    Entry& e = dir.get_or_add(static_cast<uint32_t>(id));
+    append(e, score);
+    add_total(e, id, score);
+    agg.add(score);
+  }
+  // Sorting the batch by id turns each id's scores into one run: one directory lookup
+  // and one total update per id, and new ids reach each sparse block in key order, so
+  // they append instead of shifting.
+  void insert_batch(const pair<int, int>* recs, size_t n) override {
+    if (n == 0) return;
+    agg.add(recs, n);
+    vector<pair<int, int>> batch(recs, recs + n);
+    sort_by_id(batch);
+    for (size_t i = 0; i < n;) {
+      int id = batch[i].first;
+      Entry& e = dir.get_or_add(static_cast<uint32_t>(id));
+      long long run = 0;
+      for (; i < n && batch[i].first == id; ++i) {
+        append(e, batch[i].second);
+        run += batch[i].second;
+      }
+      add_total(e, id, run);
+    }
+  }
+  size_t erase(int id) override {
+    Entry* found = dir.find(static_cast<uint32_t>(id));
+    if (!found) return 0;
+    size_t n = found->count;
+    long long removed = 0;
+    for (uint32_t c = found->first; c != NONE; c = next[c]) {
+      int* p = pool.data() + static_cast<size_t>(c) * CHUNK;
+      for (int i = 0; i < CHUNK; ++i) removed += p[i];
+      fill(p, p + CHUNK, 0);
+      free_chunks.push_back(c);
+    }
+    add_total(*found, id, -found->total);
+    dir.erase(static_cast<uint32_t>(id));
+    agg.remove(removed, n);
+    return n;
+  }
+  bool update(int id, int old_score, int new_score) override {
+    Entry* found = dir.find(static_cast<uint32_t>(id));
+    if (!found) return false;
+    uint32_t left = found->count;
+    for (uint32_t c = found->first; c != NONE; c = next[c]) {
+      int* p = pool.data() + static_cast<size_t>(c) * CHUNK;
+      for (uint32_t i = 0; i < min<uint32_t>(left, CHUNK); ++i) {
+        if (p[i] != old_score) continue;
+        p[i] = new_score;
+        add_total(*found, id, static_cast<long long>(new_score) - old_score);
+        agg.total += static_cast<long long>(new_score) - old_score;
+        return true;
+      }
+      left -= min<uint32_t>(left, CHUNK);
+    }
+    return false;
+  }
+  template <class F>
+  size_t for_each_score(int id, F& f) const {
+    const Entry* found = dir.find(static_cast<uint32_t>(id));
+    if (!found) return 0;
+    walk(*found, f);
+    return found->count;
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    auto call = [fn, ctx](int score) { fn(ctx, score); };
+    return for_each_score(id, call);
+  }
+  long long scan_scores() const override {
+    long long s = 0;
+    for (int sc : pool) s += sc;
+    return s;
+  }
+  // Directory order is unsigned, so negative ids come after the non-negative ones.
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override {
+    auto emit = [&](uint32_t id, const Entry& e) { fn(ctx, static_cast<int>(id), e.total); };
+    if (hi >= 0 && lo <= hi) dir.for_each_in(static_cast<uint32_t>(max(lo, 0)), static_cast<uint32_t>(hi), emit);
+    if (lo < 0 && lo <= hi) dir.for_each_in(static_cast<uint32_t>(lo), static_cast<uint32_t>(min(hi, -1)), emit);
+  }
+  long long range_sum(int lo, int hi) const override {
+    if (lo > hi) return 0;
     long long s = 0;
-    for (const auto& l : array) for (int sc : l) s += sc;
+    if (hi >= 0) s += sum_unsigned(static_cast<uint32_t>(max(lo, 0)), static_cast<uint32_t>(hi));
+    if (lo < 0) s += sum_unsigned(static_cast<uint32_t>(lo), static_cast<uint32_t>(min(hi, -1)));
     return s;
   }
 };
+const int DS2::CHUNK;
+const int DS2::SPAN_BITS;
+const int DS2::SPANS;
+const size_t DS2::RADIX_MIN;
+const uint32_t DS2::NONE;
 
-class DS3 : public BaseDS {
+class DS3 final : public BaseDS {
   struct Node {
     int id;
     vector<int> scores;
@@ -82,6 +1125,7 @@ public:
     }
   }
   void insert(int id, int score) override {
+    agg.add(score);
     Node** pp = &head;
     while (*pp && (*pp)->id < id) pp = &((*pp)->next);
     if (*pp && (*pp)->id == id) {
@@ -94,13 +1138,59 @@ public:
       *pp = newn;
     }
   }
-  vector<int> search(int id) const override {
+  // Sorted batch lets one forward walk of the list place every record.
+  void insert_batch(const pair<int, int>* recs, size_t n) override {
+    agg.add(recs, n);
+    vector<pair<int, int>> batch(recs, recs + n);
+    stable_sort(batch.begin(), batch.end(), [](const pair<int, int>& a, const pair<int, int>& b) { return a.first < b.first; });
+    Node** pp = &head;
+    for (const auto& r : batch) {
+      while (*pp && (*pp)->id < r.first) pp = &((*pp)->next);
+      if (!*pp || (*pp)->id != r.first) {
+        Node* newn = new Node;
+        newn->id = r.first;
+        newn->next = *pp;
+        *pp = newn;
+      }
+      (*pp)->scores.push_back(r.second);
+    }
+  }
+  size_t erase(int id) override {
+    Node** pp = &head;
+    while (*pp && (*pp)->id < id) pp = &((*pp)->next);
+    if (!*pp || (*pp)->id != id) return 0;
+    Node* dead = *pp;
+    *pp = dead->next;
+    long long removed = 0;
+    for (int sc : dead->scores) removed += sc;
+    size_t n = dead->scores.size();
+    agg.remove(removed, n);
+    delete dead;
+    return n;
+  }
+  bool update(int id, int old_score, int new_score) override {
     Node* cur = head;
     while (cur && cur->id < id) cur = cur->next;
-    if (cur && cur->id == id) return cur->scores;
-    return {-1};
+    if (!cur || cur->id != id) return false;
+    auto it = find(cur->scores.begin(), cur->scores.end(), old_score);
+    if (it == cur->scores.end()) return false;
+    *it = new_score;
+    agg.total += static_cast<long long>(new_score) - old_score;
+    return true;
   }
-  long long sum_scores() const override {
+  template <class F>
+  size_t for_each_score(int id, F& f) const {
+    Node* cur = head;
+    while (cur && cur->id < id) cur = cur->next;
+    if (!cur || cur->id != id) return 0;
+    for (int sc : cur->scores) f(sc);
+    return cur->scores.size();
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    auto call = [fn, ctx](int score) { fn(ctx, score); };
+    return for_each_score(id, call);
+  }
+  long long scan_scores() const override {
     long long s = 0;
     Node* cur = head;
     while (cur) {
@@ -109,88 +1199,735 @@ public:
     }
     return s;
   }
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override {
+    Node* cur = head;
+    while (cur && cur->id < lo) cur = cur->next;
+    for (; cur && cur->id <= hi; cur = cur->next) {
+      long long total = 0;
+      for (int sc : cur->scores) total += sc;
+      fn(ctx, cur->id, total);
+    }
+  }
 };
 
-int main() {
+// Bump allocator handing out memory from large blocks; everything is released at once.
+class Arena {
+  static const size_t BLOCK = 1 << 16;
+  vector<unique_ptr<char[]>> blocks;
+  char* cur = nullptr;
+  size_t left = 0;
+public:
+  void* alloc(size_t bytes, size_t align = alignof(void*)) {
+    size_t pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+    if (pad + bytes > left) {
+      size_t sz = max(BLOCK, bytes + align);
+      blocks.emplace_back(new char[sz]);
+      cur = blocks.back().get();
+      left = sz;
+      pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+    }
+    char* p = cur + pad;
+    cur = p + bytes;
+    left -= pad + bytes;
+    return p;
+  }
+  template <class T>
+  T* alloc_array(size_t n) { return static_cast<T*>(alloc(sizeof(T) * n, alignof(T))); }
+};
+const size_t Arena::BLOCK;
+
+// DS3 semantics (one node per id holding all its scores) indexed by a skip list.
+// Nodes and score arrays come from an Arena, so teardown is a bulk release.
+class DS3Skip final : public BaseDS {
+  static const int MAX_LEVEL = 24;
+  struct Node {
+    int id;
+    uint32_t count;
+    uint32_t cap;
+    int* scores;
+    Node* next[1];  // really `level` entries, allocated past the end
+  };
+  Arena arena;
+  Node* head;
+  int level = 1;
+  uint32_t rng_state = 2463534242u;
+  int random_level() {
+    int lvl = 1;
+    for (;;) {
+      rng_state ^= rng_state << 13;
+      rng_state ^= rng_state >> 17;
+      rng_state ^= rng_state << 5;
+      for (int b = 0; b < 32; ++b, ++lvl) {
+        if (!((rng_state >> b) & 1) || lvl == MAX_LEVEL) return lvl;
+      }
+    }
+  }
+  Node* new_node(int id, int lvl) {
+    Node* n = static_cast<Node*>(arena.alloc(sizeof(Node) + sizeof(Node*) * (lvl - 1), alignof(Node)));
+    n->id = id;
+    n->count = 0;
+    n->cap = 0;
+    n->scores = nullptr;
+    for (int i = 0; i < lvl; ++i) n->next[i] = nullptr;
+    return n;
+  }
+  void push_score(Node* n, int score) {
+    if (n->count == n->cap) {
+      uint32_t cap = n->cap ? n->cap * 2 : 2;
+      int* grown = arena.alloc_array<int>(cap);
+      copy(n->scores, n->scores + n->count, grown);
+      n->scores = grown;
+      n->cap = cap;
+    }
+    n->scores[n->count++] = score;
+  }
+  // First node with id >= the given id, or nullptr.
+  const Node* lower(int id) const {
+    const Node* x = head;
+    for (int i = level - 1; i >= 0; --i) {
+      while (x->next[i] && x->next[i]->id < id) x = x->next[i];
+    }
+    return x->next[0];
+  }
+  const Node* find(int id) const {
+    const Node* x = lower(id);
+    return (x && x->id == id) ? x : nullptr;
+  }
+public:
+  DS3Skip() : head(new_node(0, MAX_LEVEL)) {}
+  void insert(int id, int score) override {
+    agg.add(score);
+    Node* update[MAX_LEVEL];
+    Node* x = head;
+    for (int i = level - 1; i >= 0; --i) {
+      while (x->next[i] && x->next[i]->id < id) x = x->next[i];
+      update[i] = x;
+    }
+    x = x->next[0];
+    if (!x || x->id != id) {
+      int lvl = random_level();
+      for (; level < lvl; ++level) update[level] = head;
+      x = new_node(id, lvl);
+      for (int i = 0; i < lvl; ++i) {
+        x->next[i] = update[i]->next[i];
+        update[i]->next[i] = x;
+      }
+    }
+    push_score(x, score);
+  }
+  // Unlinks the node; its memory stays in the arena until the list is destroyed.
+  size_t erase(int id) override {
+    Node* update[MAX_LEVEL];
+    Node* x = head;
+    for (int i = level - 1; i >= 0; --i) {
+      while (x->next[i] && x->next[i]->id < id) x = x->next[i];
+      update[i] = x;
+    }
+    x = x->next[0];
+    if (!x || x->id != id) return 0;
+    for (int i = 0; i < level && update[i]->next[i] == x; ++i) update[i]->next[i] = x->next[i];
+    while (level > 1 && !head->next[level - 1]) --level;
+    long long removed = 0;
+    for (uint32_t i = 0; i < x->count; ++i) removed += x->scores[i];
+    agg.remove(removed, x->count);
+    return x->count;
+  }
+  bool update(int id, int old_score, int new_score) override {
+    Node* x = const_cast<Node*>(find(id));
+    if (!x) return false;
+    int* it = std::find(x->scores, x->scores + x->count, old_score);
+    if (it == x->scores + x->count) return false;
+    *it = new_score;
+    agg.total += static_cast<long long>(new_score) - old_score;
+    return true;
+  }
+  template <class F>
+  size_t for_each_score(int id, F& f) const {
+    const Node* x = find(id);
+    if (!x) return 0;
+    for (uint32_t i = 0; i < x->count; ++i) f(x->scores[i]);
+    return x->count;
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    auto call = [fn, ctx](int score) { fn(ctx, score); };
+    return for_each_score(id, call);
+  }
+  long long scan_scores() const override {
+    long long s = 0;
+    for (const Node* x = head->next[0]; x; x = x->next[0]) {
+      for (uint32_t i = 0; i < x->count; ++i) s += x->scores[i];
+    }
+    return s;
+  }
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override {
+    for (const Node* x = lower(lo); x && x->id <= hi; x = x->next[0]) {
+      long long total = 0;
+      for (uint32_t i = 0; i < x->count; ++i) total += x->scores[i];
+      fn(ctx, x->id, total);
+    }
+  }
+};
+const int DS3Skip::MAX_LEVEL;
+
+// Id generator for the benchmark workloads, ids in [1, max_id].
+// ZIPF follows the YCSB/Gray et al. generator, so id 1 is the hottest key.
+class KeyGen {
+public:
+  enum Kind { UNIFORM, ZIPF, SEQUENTIAL, HOTSPOT };
+  explicit KeyGen(Kind kind = UNIFORM, int max_id = 1 << 20, double theta = 0.99, double hot_keys = 0.1, double hot_ops = 0.9)
+      : kind(kind), max_id(max_id), theta(theta), hot_ops(hot_ops), hot_max(max(1, static_cast<int>(max_id * hot_keys))) {
+    if (kind == ZIPF) {
+      zetan = zeta(max_id, theta);
+      double zeta2 = 1.0 + pow(0.5, theta);
+      alpha = 1.0 / (1.0 - theta);
+      eta = (1.0 - pow(2.0 / max_id, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+  }
+  int operator()(mt19937& rng) {
+    switch (kind) {
+    case ZIPF: {
+      double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+      double uz = u * zetan;
+      if (uz < 1.0) return 1;
+      if (uz < 1.0 + pow(0.5, theta)) return 2;
+      return min(max_id, 1 + static_cast<int>(max_id * pow(eta * u - eta + 1.0, alpha)));
+    }
+    case SEQUENTIAL:
+      seq = seq % max_id + 1;
+      return seq;
+    case HOTSPOT:
+      if (uniform_real_distribution<double>(0.0, 1.0)(rng) < hot_ops || hot_max == max_id) {
+        return uniform_int_distribution<int>(1, hot_max)(rng);
+      }
+      return uniform_int_distribution<int>(hot_max + 1, max_id)(rng);
+    default:
+      return uniform_int_distribution<int>(1, max_id)(rng);
+    }
+  }
+  static const char* name(Kind k) {
+    static const char* names[] = {"uniform", "zipf", "sequential", "hotspot"};
+    return names[k];
+  }
+  static bool parse(const string& s, Kind& out) {
+    for (int k = UNIFORM; k <= HOTSPOT; ++k) {
+      if (s == name(static_cast<Kind>(k))) {
+        out = static_cast<Kind>(k);
+        return true;
+      }
+    }
+    return false;
+  }
+private:
+  // sum_{i=1..n} i^-theta is max_id pow calls, so it is computed once per (n, theta) and shared by
+  // every trial, trace and worker.
+  static double zeta(int n, double theta) {
+    static mutex mu;
+    static map<pair<int, double>, double> cache;
+    lock_guard<mutex> lk(mu);
+    auto it = cache.find({n, theta});
+    if (it != cache.end()) return it->second;
+    double z = 0;
+    for (int i = 1; i <= n; ++i) z += 1.0 / pow(i, theta);
+    cache[{n, theta}] = z;
+    return z;
+  }
+  Kind kind;
+  int max_id;
+  double theta;
+  double hot_ops;
+  int hot_max;
+  double zetan = 0, alpha = 0, eta = 0;
+  int seq = 0;
+};
+
+// Direct-mapped cache of recent lookups in front of any BaseDS. Each slot keeps a
+// copy of one id's scores; inserts append to a cached copy so it never goes stale.
+class CachedDS : public BaseDS {
+  struct Slot {
+    bool valid = false;  // id is meaningless until set; every int, 0 included, is a real id
+    int id = 0;
+    vector<int> scores;
+    bool holds(int i) const { return valid && id == i; }
+  };
+  unique_ptr<BaseDS> inner;
+  size_t mask;
+  mutable vector<Slot> slots;
+  mutable size_t n_hits = 0, n_misses = 0;
+  Slot& slot_of(int id) const { return slots[(static_cast<uint32_t>(id) * 2654435761u) & mask]; }
+public:
+  // n_slots is rounded up to a power of two.
+  CachedDS(unique_ptr<BaseDS> ds, size_t n_slots = 4096) : inner(move(ds)) {
+    size_t n = 1;
+    while (n < n_slots) n <<= 1;
+    mask = n - 1;
+    slots.resize(n);
+  }
+  void insert(int id, int score) override {
+    inner->insert(id, score);
+    Slot& sl = slot_of(id);
+    if (sl.holds(id)) sl.scores.push_back(score);
+  }
+  void insert_batch(const pair<int, int>* recs, size_t n) override {
+    inner->insert_batch(recs, n);
+    for (size_t i = 0; i < n; ++i) {
+      Slot& sl = slot_of(recs[i].first);
+      if (sl.holds(recs[i].first)) sl.scores.push_back(recs[i].second);
+    }
+  }
+  size_t erase(int id) override {
+    Slot& sl = slot_of(id);
+    if (sl.holds(id)) {
+      sl.valid = false;
+      sl.scores.clear();
+    }
+    return inner->erase(id);
+  }
+  bool update(int id, int old_score, int new_score) override {
+    if (!inner->update(id, old_score, new_score)) return false;
+    Slot& sl = slot_of(id);
+    if (sl.holds(id)) *find(sl.scores.begin(), sl.scores.end(), old_score) = new_score;
+    return true;
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    Slot& sl = slot_of(id);
+    if (!sl.holds(id)) {
+      ++n_misses;
+      // Absent ids are not cached; a negative entry would need clearing on insert.
+      sl.scores.clear();
+      inner->visit(id, [](void* c, int score) { static_cast<vector<int>*>(c)->push_back(score); }, &sl.scores);
+      sl.id = id;
+      sl.valid = !sl.scores.empty();
+    } else {
+      ++n_hits;
+    }
+    for (int sc : sl.scores) fn(ctx, sc);
+    return sl.scores.size();
+  }
+  long long scan_scores() const override { return inner->scan_scores(); }
+  long long sum_scores() const override { return inner->sum_scores(); }
+  size_t count() const override { return inner->count(); }
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override { inner->visit_totals(lo, hi, fn, ctx); }
+  long long range_sum(int lo, int hi) const override { return inner->range_sum(lo, hi); }
+  vector<pair<int, long long>> top_k(size_t k) const override { return inner->top_k(k); }
+  size_t hits() const { return n_hits; }
+  size_t misses() const { return n_misses; }
+};
+
+// "<type>+Cache" puts a CachedDS in front of <type>.
+unique_ptr<BaseDS> make_ds(const string& type) {
+  const string cache_suffix = "+Cache";
+  if (type.size() > cache_suffix.size() && type.compare(type.size() - cache_suffix.size(), cache_suffix.size(), cache_suffix) == 0) {
+    return unique_ptr<BaseDS>(new CachedDS(make_ds(type.substr(0, type.size() - cache_suffix.size()))));
+  }
+  if (type == "DS1") return unique_ptr<BaseDS>(new DS1());
+  if (type == "DS1SoA") return unique_ptr<BaseDS>(new DS1SoA());
+  if (type == "DS1Lsm") return unique_ptr<BaseDS>(new DS1Lsm());
+  if (type == "DS2") return unique_ptr<BaseDS>(new DS2());
+  if (type == "DS3Skip") return unique_ptr<BaseDS>(new DS3Skip());
+  return unique_ptr<BaseDS>(new DS3());
+}
+
+// Compile-time handle on a concrete structure. Drivers templated on a Store hold the
+// structure by value, so insert/search/sum are direct calls the compiler can inline;
+// make_ds() and BaseDS stay the virtual adapter for wrapped and mixed use.
+template <class DS>
+struct Store {
+  using type = DS;
+};
+
+// Calls f(Store<DS>()) for a plain structure name; false for wrapped (+Cache) or unknown names.
+template <class F>
+bool with_store(const string& type, F&& f) {
+  if (type == "DS1") f(Store<DS1>());
+  else if (type == "DS1SoA") f(Store<DS1SoA>());
+  else if (type == "DS1Lsm") f(Store<DS1Lsm>());
+  else if (type == "DS2") f(Store<DS2>());
+  else if (type == "DS3") f(Store<DS3>());
+  else if (type == "DS3Skip") f(Store<DS3Skip>());
+  else return false;
+  return true;
+}
+
+// Thread-safe wrapper: id goes to shard id % shards and is stored there as id / shards,
+// so every shard sees a dense id range. Each shard owns its own structure behind a
+// reader-writer lock; aggregate reads fan out over all shards.
+class ShardedDS : public BaseDS {
+  struct alignas(64) Shard {
+    unique_ptr<BaseDS> ds;
+    mutable shared_mutex mu;
+  };
+  size_t n_shards;
+  unique_ptr<Shard[]> shards;
+  Shard& shard_of(int id) const { return shards[static_cast<unsigned>(id) % n_shards]; }
+  int local_id(int id) const { return static_cast<int>(static_cast<unsigned>(id) / n_shards); }
+  int global_id(size_t shard, int local) const { return static_cast<int>(static_cast<unsigned>(local) * n_shards + shard); }
+  // Calls f(shard, llo, lhi) with the local id range each shard holds of global [lo, hi].
+  template <class F>
+  void for_each_local_range(int lo, int hi, F f) const {
+    if (lo > hi) return;
+    if (n_shards == 1) {
+      f(0, lo, hi);
+      return;
+    }
+    // Routing works on unsigned ids, so split at zero: [lo, -1] maps above [0, hi].
+    pair<unsigned, unsigned> parts[2];
+    int n_parts = 0;
+    if (hi >= 0) parts[n_parts++] = {static_cast<unsigned>(max(lo, 0)), static_cast<unsigned>(hi)};
+    if (lo < 0) parts[n_parts++] = {static_cast<unsigned>(lo), static_cast<unsigned>(min(hi, -1))};
+    for (size_t s = 0; s < n_shards; ++s) {
+      for (int p = 0; p < n_parts; ++p) {
+        unsigned a = parts[p].first, b = parts[p].second;
+        if (b < s) continue;
+        unsigned llo = a <= s ? 0 : (a - s + n_shards - 1) / n_shards;
+        unsigned lhi = (b - s) / n_shards;
+        if (llo <= lhi) f(s, static_cast<int>(llo), static_cast<int>(lhi));
+      }
+    }
+  }
+public:
+  ShardedDS(const string& type, size_t n) : n_shards(n), shards(new Shard[n]) {
+    for (size_t i = 0; i < n; ++i) shards[i].ds = make_ds(type);
+  }
+  void insert(int id, int score) override {
+    Shard& sh = shard_of(id);
+    unique_lock<shared_mutex> lk(sh.mu);
+    sh.ds->insert(local_id(id), score);
+  }
+  void insert_batch(const pair<int, int>* recs, size_t n) override {
+    vector<vector<pair<int, int>>> parts(n_shards);
+    for (size_t i = 0; i < n; ++i) parts[static_cast<unsigned>(recs[i].first) % n_shards].push_back({local_id(recs[i].first), recs[i].second});
+    for (size_t i = 0; i < n_shards; ++i) {
+      unique_lock<shared_mutex> lk(shards[i].mu);
+      shards[i].ds->insert_batch(parts[i].data(), parts[i].size());
+    }
+  }
+  size_t erase(int id) override {
+    Shard& sh = shard_of(id);
+    unique_lock<shared_mutex> lk(sh.mu);
+    return sh.ds->erase(local_id(id));
+  }
+  bool update(int id, int old_score, int new_score) override {
+    Shard& sh = shard_of(id);
+    unique_lock<shared_mutex> lk(sh.mu);
+    return sh.ds->update(local_id(id), old_score, new_score);
+  }
+  size_t visit(int id, ScoreVisitor fn, void* ctx) const override {
+    Shard& sh = shard_of(id);
+    shared_lock<shared_mutex> lk(sh.mu);
+    return sh.ds->visit(local_id(id), fn, ctx);
+  }
+  long long scan_scores() const override {
+    long long s = 0;
+    for (size_t i = 0; i < n_shards; ++i) {
+      shared_lock<shared_mutex> lk(shards[i].mu);
+      s += shards[i].ds->scan_scores();
+    }
+    return s;
+  }
+  long long sum_scores() const override {
+    long long s = 0;
+    for (size_t i = 0; i < n_shards; ++i) {
+      shared_lock<shared_mutex> lk(shards[i].mu);
+      s += shards[i].ds->sum_scores();
+    }
+    return s;
+  }
+  size_t count() const override {
+    size_t c = 0;
+    for (size_t i = 0; i < n_shards; ++i) {
+      shared_lock<shared_mutex> lk(shards[i].mu);
+      c += shards[i].ds->count();
+    }
+    return c;
+  }
+  void visit_totals(int lo, int hi, TotalVisitor fn, void* ctx) const override {
+    struct Remap {
+      const ShardedDS* self;
+      size_t shard;
+      TotalVisitor fn;
+      void* ctx;
+    };
+    for_each_local_range(lo, hi, [&](size_t s, int llo, int lhi) {
+      Remap r{this, s, fn, ctx};
+      shared_lock<shared_mutex> lk(shards[s].mu);
+      shards[s].ds->visit_totals(llo, lhi, [](void* c, int id, long long total) {
+        Remap& r = *static_cast<Remap*>(c);
+        r.fn(r.ctx, r.self->global_id(r.shard, id), total);
+      }, &r);
+    });
+  }
+  long long range_sum(int lo, int hi) const override {
+    long long s = 0;
+    for_each_local_range(lo, hi, [&](size_t sh, int llo, int lhi) {
+      shared_lock<shared_mutex> lk(shards[sh].mu);
+      s += shards[sh].ds->range_sum(llo, lhi);
+    });
+    return s;
+  }
+  // Each id lives in one shard, so the global top k is among the per-shard top k.
+  vector<pair<int, long long>> top_k(size_t k) const override {
+    vector<pair<int, long long>> all;
+    for (size_t i = 0; i < n_shards; ++i) {
+      vector<pair<int, long long>> part;
+      {
+        shared_lock<shared_mutex> lk(shards[i].mu);
+        part = shards[i].ds->top_k(k);
+      }
+      for (auto& e : part) all.push_back({global_id(i, e.first), e.second});
+    }
+    sort(all.begin(), all.end(), rank_before);
+    if (all.size() > k) all.resize(k);
+    return all;
+  }
+};
+
+struct TrialTimes {
+  double ins = 0, srch = 0, sum = 0;
+};
+
+// One independent trial: bulk insert n random records, 100k searches, one full scan.
+// DS is either a concrete structure (direct calls) or BaseDS (virtual calls).
+template <class DS>
+TrialTimes run_trial(DS& ds, int n, unsigned seed, KeyGen::Kind keys) {
+  TrialTimes t;
+  mt19937 rng(seed);
+  KeyGen id_d(keys);
+  uniform_int_distribution<int> sc_d(0, 100);
+  vector<pair<int, int>> recs(n);
+  for (auto& r : recs) r = {id_d(rng), sc_d(rng)};
+  auto start = chrono::steady_clock::now();
+  ds.insert_batch(recs.data(), recs.size());
+  auto end = chrono::steady_clock::now();
+  t.ins = chrono::duration<double>(end - start).count();
+  vector<int> srch_ids(100000);
+  for (int& sid : srch_ids) sid = id_d(rng);
+  long long hits = 0;
+  auto add = [&hits](int sc) { hits += sc; };
+  start = chrono::steady_clock::now();
+  for (int sid : srch_ids) ds.for_each_score(sid, add);
+  end = chrono::steady_clock::now();
+  volatile long long srch_sink = hits;
+  t.srch = chrono::duration<double>(end - start).count();
+  start = chrono::steady_clock::now();
+  volatile long long total = ds.scan_scores();
+  end = chrono::steady_clock::now();
+  t.sum = chrono::duration<double>(end - start).count();
+  return t;
+}
+
+TrialTimes run_trial(const string& type, int n, unsigned seed, KeyGen::Kind keys) {
+  TrialTimes t;
+  bool direct = with_store(type, [&](auto store) {
+    typename decltype(store)::type ds;
+    t = run_trial(ds, n, seed, keys);
+  });
+  if (!direct) {
+    unique_ptr<BaseDS> ds = make_ds(type);
+    t = run_trial(*ds, n, seed, keys);
+  }
+  return t;
+}
+
+// Runs trials 0..n_trials-1 on `jobs` worker threads, each pinned to its own core.
+// Trial i is seeded with base_seed + i regardless of which worker picks it up.
+vector<TrialTimes> run_trials(const string& type, int n, int n_trials, unsigned base_seed, int jobs, KeyGen::Kind keys) {
+  vector<TrialTimes> res(n_trials);
+  if (jobs <= 1) {
+    for (int i = 0; i < n_trials; ++i) res[i] = run_trial(type, n, base_seed + i, keys);
+    return res;
+  }
+  atomic<int> next_trial(0);
+  vector<thread> workers;
+  unsigned n_cpus = max(1u, thread::hardware_concurrency());
+  for (int w = 0; w < jobs; ++w) {
+    workers.emplace_back([&] {
+      for (int i; (i = next_trial++) < n_trials;) res[i] = run_trial(type, n, base_seed + i, keys);
+    });
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w % n_cpus, &set);
+    pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+#endif
+  }
+  for (auto& w : workers) w.join();
+  return res;
+}
+
+// Two-sided 95% Student-t critical values for df = 1..30; larger df use the normal value.
+inline double t_crit95(size_t df) {
+  static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                             2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                             2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  return df == 0 ? INFINITY : df <= 30 ? t[df - 1] : 1.960;
+}
+
+struct Summary {
+  double mean = 0, median = 0, stddev = 0, ci95 = INFINITY;  // ci95 is the half-width around mean
+  size_t kept = 0, outliers = 0;
+};
+
+inline double quantile_sorted(const vector<double>& xs, double q) {
+  double pos = q * (xs.size() - 1);
+  size_t lo = static_cast<size_t>(pos);
+  size_t hi = min(lo + 1, xs.size() - 1);
+  return xs[lo] + (xs[hi] - xs[lo]) * (pos - lo);
+}
+
+// Drops samples outside Tukey's 1.5 * IQR fences (from 4 samples on), then summarizes the rest.
+inline Summary summarize(vector<double> xs) {
+  Summary r;
+  if (xs.empty()) return r;
+  sort(xs.begin(), xs.end());
+  if (xs.size() >= 4) {
+    double q1 = quantile_sorted(xs, 0.25), q3 = quantile_sorted(xs, 0.75);
+    double lo = q1 - 1.5 * (q3 - q1), hi = q3 + 1.5 * (q3 - q1);
+    vector<double> kept;
+    for (double x : xs) {
+      if (x >= lo && x <= hi) kept.push_back(x);
+    }
+    r.outliers = xs.size() - kept.size();
+    xs.swap(kept);
+  }
+  r.kept = xs.size();
+  r.median = quantile_sorted(xs, 0.5);
+  for (double x : xs) r.mean += x;
+  r.mean /= xs.size();
+  if (xs.size() >= 2) {
+    double ss = 0;
+    for (double x : xs) ss += (x - r.mean) * (x - r.mean);
+    r.stddev = sqrt(ss / (xs.size() - 1));
+    r.ci95 = t_crit95(xs.size() - 1) * r.stddev / sqrt(static_cast<double>(xs.size()));
+  }
+  return r;
+}
+
+struct HarnessConfig {
+  int jobs = 1;
+  KeyGen::Kind keys = KeyGen::UNIFORM;
+  int warmup = 1;          // discarded trials per cell
+  int min_trials = 5;
+  int max_trials = 30;
+  double rel_ci = 0.05;    // stop once every metric's CI half-width is within this fraction of its mean
+  double budget = 60.0;    // wall-clock seconds per (type, k) cell, warmup included
+};
+
+struct CellResult {
+  Summary ins, srch, sum;
+  size_t trials = 0;
+  bool over_budget = false;  // the budget ran out before min_trials measured trials
+  double batch_time = 0;     // seconds taken by the last batch run, warmup or measured
+};
+
+// Warms up, then repeats trials in batches of cfg.jobs until the CIs are tight,
+// max_trials is reached, or the next batch would overrun the cell's time budget.
+// Warmup batches count against the budget too; est_batch (0 = unknown) is the expected
+// seconds per batch, so a cell whose warmup plus one measured batch cannot fit is not started.
+CellResult run_cell(const string& type, int n, const HarnessConfig& cfg, double est_batch = 0) {
+  CellResult r;
+  unsigned seed = random_device{}();
+  auto cell_start = chrono::steady_clock::now();
+  auto elapsed = [&] { return chrono::duration<double>(chrono::steady_clock::now() - cell_start).count(); };
+  double batch_time = est_batch;
+  int warm_batches = (cfg.warmup + cfg.jobs - 1) / cfg.jobs;
+  if (batch_time * (warm_batches + 1) > cfg.budget) {
+    r.over_budget = true;
+    return r;
+  }
+  for (int done = 0; done < cfg.warmup; done += cfg.jobs) {
+    if (elapsed() + batch_time > cfg.budget) {
+      r.over_budget = true;
+      r.batch_time = batch_time;
+      return r;
+    }
+    int batch = min(cfg.jobs, cfg.warmup - done);
+    auto batch_start = chrono::steady_clock::now();
+    run_trials(type, n, batch, seed, cfg.jobs, cfg.keys);
+    seed += batch;
+    batch_time = chrono::duration<double>(chrono::steady_clock::now() - batch_start).count();
+  }
+  vector<double> ins, srch, sum;
+  while (static_cast<int>(ins.size()) < cfg.max_trials) {
+    if (elapsed() + batch_time > cfg.budget) {
+      r.over_budget = static_cast<int>(ins.size()) < cfg.min_trials;
+      break;
+    }
+    int batch = min(cfg.jobs, cfg.max_trials - static_cast<int>(ins.size()));
+    auto batch_start = chrono::steady_clock::now();
+    for (const TrialTimes& t : run_trials(type, n, batch, seed, cfg.jobs, cfg.keys)) {
+      ins.push_back(t.ins);
+      srch.push_back(t.srch);
+      sum.push_back(t.sum);
+    }
+    seed += batch;
+    batch_time = chrono::duration<double>(chrono::steady_clock::now() - batch_start).count();
+    if (static_cast<int>(ins.size()) < cfg.min_trials) continue;
+    r.ins = summarize(ins);
+    r.srch = summarize(srch);
+    r.sum = summarize(sum);
+    auto tight = [&](const Summary& m) { return m.ci95 <= cfg.rel_ci * m.mean; };
+    if (tight(r.ins) && tight(r.srch) && tight(r.sum)) break;
+  }
+  r.trials = ins.size();
+  r.batch_time = batch_time;
+  r.ins = summarize(ins);
+  r.srch = summarize(srch);
+  r.sum = summarize(sum);
+  return r;
+}
+
+// ./main [--jobs N] [--keys uniform|zipf|sequential|hotspot] [--budget S] [--rel-ci F]
+//        [--warmup N] [--min-trials N] [--max-trials N]
+// --jobs N > 1 runs the trials of a cell concurrently; --keys picks the id distribution.
+// Each (type, k) cell gets --budget seconds; once a cell cannot fit --min-trials trials,
+// larger k for that type are skipped rather than estimated.
+int main(int argc, char** argv) {
+  HarnessConfig cfg;
+  for (int i = 1; i + 1 < argc; ++i) {
+    string opt = argv[i];
+    if (opt == "--jobs") cfg.jobs = max(1, atoi(argv[i + 1]));
+    else if (opt == "--budget") cfg.budget = atof(argv[i + 1]);
+    else if (opt == "--rel-ci") cfg.rel_ci = atof(argv[i + 1]);
+    else if (opt == "--warmup") cfg.warmup = max(0, atoi(argv[i + 1]));
+    else if (opt == "--min-trials") cfg.min_trials = max(2, atoi(argv[i + 1]));
+    else if (opt == "--max-trials") cfg.max_trials = max(2, atoi(argv[i + 1]));
+    else if (opt == "--keys" && !KeyGen::parse(argv[i + 1], cfg.keys)) {
+      cerr << "unknown key distribution " << argv[i + 1] << "\n";
+      return 1;
+    }
+  }
+  cfg.max_trials = max(cfg.max_trials, cfg.min_trials);
   vector<int> ks(15);
   for (int i = 0; i < 15; ++i) ks[i] = 11 + i;
-  vector<string> types{"DS1", "DS2", "DS3"};
+  vector<string> types{"DS1", "DS1SoA", "DS1Lsm", "DS2", "DS3", "DS3Skip"};
   ofstream out("results.csv");
-  out << "Type,k,n,insert,search100k,sum,estimated\n";
+  // insert/search100k/sum are outlier-filtered means; estimated stays for plot.py and is always 0.
+  out << "Type,k,n,insert,search100k,sum,estimated,trials";
+  for (const char* m : {"insert", "search100k", "sum"}) out << "," << m << "_median," << m << "_stddev," << m << "_ci95," << m << "_outliers";
+  out << "\n";
   for (const string& type : types) {
     cout << "Type: " << type << endl;
-    double ins_power, srch_power, sum_power;
-    if (type == "DS1") {
-      ins_power = 2.0;
-      srch_power = 1.0;
-      sum_power = 1.0;
-    } else if (type == "DS2") {
-      ins_power = 1.0;
-      srch_power = 1.0;
-      sum_power = 1.0;
-    } else {
-      ins_power = 1.0;
-      srch_power = 0.0;
-      sum_power = 1.0;
-    }
-    double prev_k = -1;
-    double prev_avg_ins = 0, prev_avg_srch = 0, prev_avg_sum = 0;
-    bool prev_exceeded = false;
+    double last_batch = 0;
     for (int k : ks) {
       int n = 1 << k;
-      int delta = k - prev_k;
-      double scale_ins = (prev_k < 0) ? 1.0 : pow(2.0, ins_power * delta);
-      double pred_avg_ins = prev_avg_ins * scale_ins;
-      double pred_total_ins_time = pred_avg_ins * 10;
-      bool use_estimate = prev_exceeded;
-
-      if (use_estimate) {
-        double scale_srch = pow(2.0, srch_power * delta);
-        double scale_sum = pow(2.0, sum_power * delta);
-        double est_ins = prev_avg_ins * scale_ins;
-        double est_srch = prev_avg_srch * scale_srch;
-        double est_sum = prev_avg_sum * scale_sum;
-        cout << "  k=" << k << ", n=" << n << ", estimated insert=" << est_ins << "s, search100k=" << est_srch << "s, sum=" << est_sum << "s (skipped)\n";
-        out << type << "," << k << "," << n << "," << est_ins << "," << est_srch << "," << est_sum << ",1\n";
-      } else {
-        double ins_time = 0, srch_time = 0, sum_time = 0;
-        for (int trial = 0; trial < 10; ++trial) {
-          unique_ptr<BaseDS> ds;
-          if (type == "DS1") ds.reset(new DS1());
-          else if (type == "DS2") ds.reset(new DS2());
-          else ds.reset(new DS3());
-          mt19937 rng(random_device{}() + trial);
-          uniform_int_distribution<int> id_d(1, 1 << 20);
-          uniform_int_distribution<int> sc_d(0, 100);
-          auto start = chrono::steady_clock::now();
-          for (int i = 0; i < n; ++i) ds->insert(id_d(rng), sc_d(rng));
-          auto end = chrono::steady_clock::now();
-          ins_time += chrono::duration<double>(end - start).count();
-          vector<int> srch_ids(100000);
-          for (int& sid : srch_ids) sid = id_d(rng);
-          start = chrono::steady_clock::now();
-          for (int sid : srch_ids) {
-            volatile auto res = ds->search(sid);
-          }
-          end = chrono::steady_clock::now();
-          srch_time += chrono::duration<double>(end - start).count();
-          start = chrono::steady_clock::now();
-          volatile long long total = ds->sum_scores();
-          end = chrono::steady_clock::now();
-          sum_time += chrono::duration<double>(end - start).count();
-        }
-        double avg_ins = ins_time / 10;
-        double avg_srch = srch_time / 10;
-        double avg_sum = sum_time / 10;
-        cout << "  k=" << k << ", n=" << n << ", insert=" << avg_ins << "s, search100k=" << avg_srch << "s, sum=" << avg_sum << "s\n";
-        out << type << "," << k << "," << n << "," << avg_ins << "," << avg_srch << "," << avg_sum << ",0\n";
-        prev_k = k;
-        prev_avg_ins = avg_ins;
-        prev_avg_srch = avg_srch;
-        prev_avg_sum = avg_sum;
-        prev_exceeded = (avg_ins * 10 > 600);
+      // n doubles with k and no structure inserts in less than linear time, so twice the
+      // last batch is a lower bound for this k's batches.
+      CellResult c = run_cell(type, n, cfg, 2 * last_batch);
+      last_batch = c.batch_time;
+      if (c.trials == 0) {
+        cout << "  k=" << k << ", n=" << n << ": no trial fits the " << cfg.budget << "s budget, skipping larger k\n";
+        break;
+      }
+      cout << "  k=" << k << ", n=" << n << ", trials=" << c.trials << ", insert=" << c.ins.median << "s (+-" << c.ins.ci95
+           << "), search100k=" << c.srch.median << "s (+-" << c.srch.ci95 << "), sum=" << c.sum.median << "s (+-" << c.sum.ci95 << ")\n";
+      out << type << "," << k << "," << n << "," << c.ins.mean << "," << c.srch.mean << "," << c.sum.mean << ",0," << c.trials;
+      for (const Summary* m : {&c.ins, &c.srch, &c.sum}) out << "," << m->median << "," << m->stddev << "," << m->ci95 << "," << m->outliers;
+      out << "\n";
+      if (c.over_budget) {
+        cout << "  only " << c.trials << " trials fit the " << cfg.budget << "s budget, skipping larger k\n";
+        break;
       }
     }
   }
   return 0;
-}
\ No newline at end of file
+}
@@ -8,171 +8,600 @@
 #include <chrono>
 #include <fstream>
 #include <set>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
 using namespace std;
 
-struct BaseDS {
-  virtual ~BaseDS() = default;
-  virtual void insert(int id, int score) = 0;
-  virtual vector<int> search(int id) const = 0;
-  virtual long long sum_scores() const = 0;
-};
+// Reuse data structure definitions from main.cpp but ignore its main()
+#define main main_unused_for_mix
+#include "main.cpp"
+#undef main
 
-class DS1 : public BaseDS {
-  vector<pair<int, int>> data;
+// HDR 風格的延遲直方圖: 每個 2 的冪次再切 16 格, 相對誤差約 6%
+class LatencyHistogram {
+    static const int SUB_BITS = 4;
+    static const int SUB = 1 << SUB_BITS;
+    vector<uint64_t> counts = vector<uint64_t>((64 - SUB_BITS + 1) * SUB, 0);
+    uint64_t total = 0;
+    uint64_t max_ns = 0;
+    
+    static size_t bucket(uint64_t v) {
+        if (v < SUB) return v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB + ((v >> shift) & (SUB - 1));
+    }
+    // 回傳該格的上界, 讓百分位數偏保守
+    static uint64_t bucket_high(size_t b) {
+        if (b < SUB) return b;
+        int shift = static_cast<int>(b / SUB) - 1;
+        uint64_t base = (static_cast<uint64_t>(SUB) | (b % SUB)) << shift;
+        return base + (1ull << shift) - 1;
+    }
+    
 public:
-  DS1() { data.reserve(1); }
-  void insert(int id, int score) override {
-    if (data.size() == data.capacity()) {
-      size_t new_cap = data.capacity() * 10;
-      if (new_cap < 1) new_cap = 1;
-      data.reserve(new_cap);
-    }
-    auto it = lower_bound(data.begin(), data.end(), id, [](const pair<int, int>& p, int i) { return p.first < i; });
-    data.insert(it, {id, score});
-  }
-  vector<int> search(int id) const override {
-    auto lit = lower_bound(data.begin(), data.end(), id, [](const pair<int, int>& p, int i) { return p.first < i; });
-    auto uit = upper_bound(lit, data.end(), id, [](int i, const pair<int, int>& p) { return i < p.first; });
-    vector<int> res;
-    for (auto it = lit; it != uit; ++it) res.push_back(it->second);
-    return res.empty() ? vector<int>{-1} : res;
-  }
-  long long sum_scores() const override {
-    long long s = 0;
-    for (const auto& p : data) s += p.second;
-    return s;
-  }
+    void record(uint64_t ns) {
+        ++counts[bucket(ns)];
+        ++total;
+        if (ns > max_ns) max_ns = ns;
+    }
+    uint64_t count() const { return total; }
+    uint64_t max() const { return max_ns; }
+    uint64_t percentile(double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(ceil(p / 100.0 * total));
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < counts.size(); ++b) {
+            seen += counts[b];
+            if (seen >= rank) return min(bucket_high(b), max_ns);
+        }
+        return max_ns;
+    }
 };
 
-class DS2 : public BaseDS {
-  static const int MAX_ID = 1 << 20;
-  vector<list<int>> array;
-public:
-  DS2() : array(MAX_ID + 1) {}
-  void insert(int id, int score) override {
-    array[id].push_back(score);
-  }
-  vector<int> search(int id) const override {
-    const auto& l = array[id];
-    return l.empty() ? vector<int>{-1} : vector<int>(l.begin(), l.end());
-  }
-  long long sum_scores() const override {
-    long long s = 0;
-    for (const auto& l : array) for (int sc : l) s += sc;
-    return s;
-  }
+const int total_ops = 100000;
+const int range_span_max = 1 << 16;  // range 查詢涵蓋 [lo, lo + span), span 均勻取 1..此值
+const int topk_k = 10;
+
+struct Workload {
+    int ins_pct, srch_pct, sum_pct, del_pct, range_pct, topk_pct;
+    string name;
+    KeyGen::Kind keys;  // id 分布
+};
+
+// 不同操作比例: (insert%, search%, sum%, erase%, range_sum%, top-k%)
+const vector<Workload> workloads = {
+    {70, 30, 0, 0, 0, 0, "Write-Heavy", KeyGen::UNIFORM},               // 寫入為主
+    {30, 70, 0, 0, 0, 0, "Read-Heavy", KeyGen::UNIFORM},                // 讀取為主
+    {33, 33, 34, 0, 0, 0, "Balanced", KeyGen::UNIFORM},                 // 均衡
+    {10, 85, 5, 0, 0, 0, "Query-Intensive", KeyGen::UNIFORM},           // 查詢密集
+    {50, 40, 10, 0, 0, 0, "Mixed-Analytics", KeyGen::UNIFORM},          // 混合分析
+    {30, 70, 0, 0, 0, 0, "Read-Heavy-Zipf", KeyGen::ZIPF},              // 少數熱門 id (theta = 0.99)
+    {10, 90, 0, 0, 0, 0, "Query-Hotspot", KeyGen::HOTSPOT},             // 90% 操作落在 10% 的 id
+    {70, 30, 0, 0, 0, 0, "Write-Heavy-Sequential", KeyGen::SEQUENTIAL}, // id 依序遞增
+    {40, 30, 0, 30, 0, 0, "Delete-Heavy", KeyGen::UNIFORM},             // 大量刪除, DS1 的 compaction 會算進來
+    {30, 40, 0, 30, 0, 0, "Delete-Heavy-Zipf", KeyGen::ZIPF},           // 熱門 id 反覆刪除再插入
+    {40, 20, 0, 0, 38, 2, "Range-Analytics", KeyGen::UNIFORM}           // id 區間加總與 top-k, 與寫入交錯
+};
+
+// 單執行緒模式比較的結構; +Cache 為前面加一層 hot-key cache
+const vector<string> ds_types = {"DS1", "DS1+Cache", "DS1SoA", "DS1Lsm", "DS2", "DS3", "DS3+Cache", "DS3Skip"};
+
+// 二進位 trace: TraceHeader 後面緊接 n_ops 筆 8 bytes 的 TraceOp
+// OP_RANGE 的 id/score 是區間起點與長度, OP_TOPK 的 score 是 k
+enum TraceOpKind : uint32_t { OP_INSERT = 0, OP_SEARCH = 1, OP_SUM = 2, OP_ERASE = 3, OP_RANGE = 4, OP_TOPK = 5 };
+
+struct TraceOp {
+    int32_t id;
+    uint32_t op_score;  // 高 3 bits 是 op, 低 29 bits 是有號 score
+    
+    uint32_t op() const { return op_score >> 29; }
+    int score() const { return static_cast<int32_t>(op_score << 3) >> 3; }
+    static TraceOp make(uint32_t op, int id, int score) {
+        return {id, (op << 29) | (static_cast<uint32_t>(score) & 0x1fffffffu)};
+    }
+};
+
+const char TRACE_MAGIC[8] = {'D', 'S', 'T', 'R', 'A', 'C', 'E', '\0'};
+const uint32_t TRACE_VERSION = 2;  // 2: op 欄位由 2 bits 加寬為 3 bits
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t op_size;  // sizeof(TraceOp), 防止讀到不同編譯出來的檔
+    uint64_t n_ops;
 };
 
-class DS3 : public BaseDS {
-  struct Node {
-    int id;
-    vector<int> scores;
-    Node* next;
-    Node() : next(nullptr) {}
-  };
-  Node* head;
+// 依 workload 比例事先產生整段操作, 計時區間內不再抽亂數
+// erase 從先前插入過的 id 中挑, 否則在 2^20 的 id 空間裡幾乎都刪不到東西
+vector<TraceOp> generate_trace(int ins_pct, int srch_pct, int del_pct, int range_pct, int topk_pct,
+                               KeyGen::Kind keys, size_t n_ops, unsigned seed) {
+    mt19937 rng(seed);
+    KeyGen id_dist(keys);
+    uniform_int_distribution<int> score_dist(0, 100);
+    uniform_int_distribution<int> span_dist(1, range_span_max);
+    uniform_int_distribution<int> op_dist(1, 100);
+    vector<TraceOp> ops(n_ops);
+    vector<int> inserted;
+    for (auto& t : ops) {
+        int op = op_dist(rng);
+        if (op <= ins_pct) {
+            int id = id_dist(rng);
+            t = TraceOp::make(OP_INSERT, id, score_dist(rng));
+            if (del_pct) inserted.push_back(id);
+        } else if (op <= ins_pct + srch_pct) {
+            t = TraceOp::make(OP_SEARCH, id_dist(rng), 0);
+        } else if (op <= ins_pct + srch_pct + del_pct) {
+            int id = inserted.empty() ? id_dist(rng) : inserted[uniform_int_distribution<size_t>(0, inserted.size() - 1)(rng)];
+            t = TraceOp::make(OP_ERASE, id, 0);
+        } else if (op <= ins_pct + srch_pct + del_pct + range_pct) {
+            int lo = id_dist(rng);
+            t = TraceOp::make(OP_RANGE, lo, span_dist(rng));
+        } else if (op <= ins_pct + srch_pct + del_pct + range_pct + topk_pct) {
+            t = TraceOp::make(OP_TOPK, 0, topk_k);
+        } else {
+            t = TraceOp::make(OP_SUM, 0, 0);
+        }
+    }
+    return ops;
+}
+
+bool write_trace(const string& path, const vector<TraceOp>& ops) {
+    ofstream f(path, ios::binary);
+    if (!f) return false;
+    TraceHeader h;
+    memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+    h.version = TRACE_VERSION;
+    h.op_size = sizeof(TraceOp);
+    h.n_ops = ops.size();
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    f.write(reinterpret_cast<const char*>(ops.data()), ops.size() * sizeof(TraceOp));
+    return static_cast<bool>(f);
+}
+
+// 以 mmap 唯讀開啟 trace, 直接把對應到的記憶體當成 TraceOp 陣列
+class MappedTrace {
+    MappedFile file;
 public:
-  DS3() : head(nullptr) {}
-  ~DS3() override {
-    Node* cur = head;
-    while (cur) {
-      Node* nxt = cur->next;
-      delete cur;
-      cur = nxt;
-    }
-  }
-  void insert(int id, int score) override {
-    Node** pp = &head;
-    while (*pp && (*pp)->id < id) pp = &((*pp)->next);
-    if (*pp && (*pp)->id == id) {
-      (*pp)->scores.push_back(score);
-    } else {
-      Node* newn = new Node;
-      newn->id = id;
-      newn->scores.push_back(score);
-      newn->next = *pp;
-      *pp = newn;
-    }
-  }
-  vector<int> search(int id) const override {
-    Node* cur = head;
-    while (cur && cur->id < id) cur = cur->next;
-    if (cur && cur->id == id) return cur->scores;
-    return {-1};
-  }
-  long long sum_scores() const override {
-    long long s = 0;
-    Node* cur = head;
-    while (cur) {
-      for (int sc : cur->scores) s += sc;
-      cur = cur->next;
-    }
-    return s;
-  }
+    const TraceOp* ops = nullptr;
+    size_t n_ops = 0;
+    
+    bool open(const string& path, string& err) {
+        if (!file.open(path, err)) return false;
+        if (file.size() < sizeof(TraceHeader)) {
+            err = path + ": too short for a trace header";
+            return false;
+        }
+        const TraceHeader* h = reinterpret_cast<const TraceHeader*>(file.data());
+        if (memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) != 0 || h->version != TRACE_VERSION ||
+            h->op_size != sizeof(TraceOp)) {
+            err = path + ": not a version " + to_string(TRACE_VERSION) + " trace";
+            return false;
+        }
+        if (h->n_ops > (file.size() - sizeof(TraceHeader)) / sizeof(TraceOp)) {
+            err = path + ": truncated, header claims " + to_string(h->n_ops) + " ops";
+            return false;
+        }
+        file.advise(MADV_SEQUENTIAL);
+        const TraceOp* p = reinterpret_cast<const TraceOp*>(file.data() + sizeof(TraceHeader));
+        // 3 bits 的 op 還容得下 6, 7; replay 拿 op 當 hist 的索引, 先整段掃一次擋掉
+        for (size_t i = 0; i < h->n_ops; ++i) {
+            if (p[i].op() > OP_TOPK) {
+                err = path + ": op " + to_string(i) + " has unknown kind " + to_string(p[i].op());
+                return false;
+            }
+        }
+        ops = p;
+        n_ops = h->n_ops;
+        return true;
+    }
 };
 
-int main() {
-    const int total_ops = 100000;
+// 把 trace 餵給任一結構, 回傳總秒數; hist 非 null 時另外記錄單次延遲
+// 記延遲每個 op 多兩次 clock 讀取, 回傳的秒數只在 hist 為 null 時可當吞吐量用
+// DS 為具體型別時全部是直接呼叫, 為 BaseDS 時走 virtual
+template <class DS>
+double replay_trace(DS& ds, const TraceOp* ops, size_t n_ops, LatencyHistogram* hist) {
+    long long hits = 0;
+    auto visit_sink = [&hits](int sc) { hits += sc; };
+    
+    auto start = chrono::steady_clock::now();
+    
+    for (size_t i = 0; i < n_ops; ++i) {
+        const TraceOp& t = ops[i];
+        auto t0 = hist ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+        switch (t.op()) {
+        case OP_INSERT:
+            ds.insert(t.id, t.score());
+            break;
+        case OP_SEARCH:
+            ds.for_each_score(t.id, visit_sink);
+            break;
+        case OP_ERASE:
+            hits += ds.erase(t.id);
+            break;
+        case OP_RANGE:
+            hits += ds.range_sum(t.id, t.id + (t.score() - 1));
+            break;
+        case OP_TOPK:
+            for (const auto& p : ds.top_k(t.score())) hits += p.second;
+            break;
+        default:
+            hits += ds.sum_scores();
+            break;
+        }
+        if (hist) {
+            hist[t.op()].record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count());
+        }
+    }
     
-    // 不同操作比例: (insert%, search%, sum%)
-    vector<tuple<int, int, int, string>> workloads = {
-        {70, 30, 0, "Write-Heavy"},      // 寫入為主
-        {30, 70, 0, "Read-Heavy"},       // 讀取為主
-        {33, 33, 34, "Balanced"},        // 均衡
-        {10, 85, 5, "Query-Intensive"},  // 查詢密集
-        {50, 40, 10, "Mixed-Analytics"}  // 混合分析
+    auto end = chrono::steady_clock::now();
+    volatile long long hit_sink = hits;
+    return chrono::duration<double>(end - start).count();
+}
+
+// 在新建的 type 結構上重播; 一般結構用具體型別, +Cache 之類的包裝走 BaseDS
+double replay_as(const string& type, const TraceOp* ops, size_t n_ops, LatencyHistogram* hist) {
+    double t = 0;
+    bool direct = with_store(type, [&](auto store) {
+        typename decltype(store)::type ds;
+        t = replay_trace(ds, ops, n_ops, hist);
+    });
+    if (!direct) {
+        unique_ptr<BaseDS> ds = make_ds(type);
+        t = replay_trace(*ds, ops, n_ops, hist);
+    }
+    return t;
+}
+
+// 在新建的 type 結構上依序套用 trace 的寫入, 並從整段 trace 均勻挑約 max_checks 個
+// range / top-k 查詢, 跟 visit_totals 全掃描算出的答案比對; 不一致時把第一筆寫進 err
+bool check_range_ops(const string& type, const TraceOp* ops, size_t n_ops, size_t max_checks, string& err) {
+    size_t n_queries = 0;
+    for (size_t i = 0; i < n_ops; ++i) {
+        if (ops[i].op() == OP_RANGE || ops[i].op() == OP_TOPK) ++n_queries;
+    }
+    size_t stride = max<size_t>(1, n_queries / max(max_checks, size_t(1)));
+    unique_ptr<BaseDS> ds = make_ds(type);
+    size_t seen = 0;
+    for (size_t i = 0; i < n_ops; ++i) {
+        const TraceOp& t = ops[i];
+        if (t.op() == OP_INSERT) ds->insert(t.id, t.score());
+        if (t.op() == OP_ERASE) ds->erase(t.id);
+        if (t.op() != OP_RANGE && t.op() != OP_TOPK) continue;
+        if (seen++ % stride != 0) continue;
+        vector<pair<int, long long>> all;
+        ds->visit_totals(INT_MIN, INT_MAX, [](void* ctx, int id, long long total) {
+            static_cast<vector<pair<int, long long>>*>(ctx)->push_back({id, total});
+        }, &all);
+        if (t.op() == OP_RANGE) {
+            int lo = t.id, hi = t.id + (t.score() - 1);
+            long long want = 0;
+            for (const auto& p : all) {
+                if (p.first >= lo && p.first <= hi) want += p.second;
+            }
+            long long got = ds->range_sum(lo, hi);
+            if (got != want) {
+                err = "op " + to_string(i) + ": range_sum(" + to_string(lo) + ", " + to_string(hi) + ") = " +
+                      to_string(got) + ", scan says " + to_string(want);
+                return false;
+            }
+        } else {
+            sort(all.begin(), all.end(), [](const pair<int, long long>& a, const pair<int, long long>& b) {
+                return a.second != b.second ? a.second > b.second : a.first < b.first;
+            });
+            all.resize(min(all.size(), static_cast<size_t>(t.score())));
+            if (ds->top_k(t.score()) != all) {
+                err = "op " + to_string(i) + ": top_k(" + to_string(t.score()) + ") differs from the scan";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// "+Cache" 型別: id 0 和跟它撞同一個 slot 的 id 交錯讀寫, 每次查詢都跟沒有 cache 的結構比對;
+// 1 << 20 是所有 2 的冪 slot 數 (≤ 2^20) 下都跟 0 同 slot 的 id
+bool check_cache_ids(const string& type, string& err) {
+    const string base = type.substr(0, type.rfind("+Cache"));
+    unique_ptr<BaseDS> cached = make_ds(type), plain = make_ds(base);
+    const int ids[] = {0, 1 << 20};
+    auto scores_of = [](const BaseDS& ds, int id) {
+        vector<int> v;
+        ds.visit(id, [](void* c, int score) { static_cast<vector<int>*>(c)->push_back(score); }, &v);
+        sort(v.begin(), v.end());
+        return v;
     };
+    for (int step = 0; step < 12; ++step) {
+        int id = ids[step % 2];
+        if (step % 3 == 0) {
+            cached->insert(id, step + 7);
+            plain->insert(id, step + 7);
+        }
+        if (step == 8) {
+            cached->erase(id);
+            plain->erase(id);
+        }
+        for (int probe : ids) {
+            if (scores_of(*cached, probe) != scores_of(*plain, probe)) {
+                err = "step " + to_string(step) + ": search(" + to_string(probe) + ") differs from " + base;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const double pcts[] = {50, 90, 99, 99.9};
+const int n_op_kinds = 6;
+const char* op_names[n_op_kinds] = {"Insert", "Search", "Sum", "Erase", "Range", "TopK"};
+
+void write_result_header(ostream& out) {
+    out << "Workload,Type,TotalTime,AvgOpTime_us,Throughput_ops_per_sec";
+    for (const char* op : op_names) {
+        out << "," << op << "_p50_ns," << op << "_p90_ns," << op << "_p99_ns,"
+            << op << "_p99.9_ns," << op << "_max_ns";
+    }
+    out << "\n";
+}
+
+void write_result_row(ostream& out, const string& name, const string& type, double avg_time,
+                      size_t n_ops, const LatencyHistogram* hist) {
+    double avg_op_time_us = (avg_time / n_ops) * 1e6;
+    double throughput = n_ops / avg_time;
     
-    ofstream out("mixed_ops_results.csv");
-    out << "Workload,Type,TotalTime,AvgOpTime_us,Throughput_ops_per_sec\n";
+    cout << "  " << type << ": " << avg_time << "s, " 
+         << throughput << " ops/sec\n";
+    cout << "    p99 ns (I/S/Sum/E/R/K): " << hist[0].percentile(99) << "/"
+         << hist[1].percentile(99) << "/" << hist[2].percentile(99) << "/"
+         << hist[3].percentile(99) << "/" << hist[4].percentile(99) << "/"
+         << hist[5].percentile(99) << "\n";
     
-    for (auto [ins_pct, srch_pct, sum_pct, name] : workloads) {
-        cout << "\nWorkload: " << name << " (I:" << ins_pct 
-             << "% S:" << srch_pct << "% Sum:" << sum_pct << "%)\n";
+    out << name << "," << type << "," << avg_time << "," 
+        << avg_op_time_us << "," << throughput;
+    for (int i = 0; i < n_op_kinds; ++i) {
+        for (double p : pcts) out << "," << hist[i].percentile(p);
+        out << "," << hist[i].max();
+    }
+    out << "\n";
+}
+
+// 多執行緒模式: total_ops 平均分給 N 個執行緒, 共用一個 ShardedDS
+void run_threaded(const vector<int>& thread_counts, size_t n_shards) {
+    ofstream out("mixed_threads_results.csv");
+    out << "Workload,Type,Threads,Shards,TotalTime,Throughput_ops_per_sec,Speedup\n";
+    
+    for (auto [ins_pct, srch_pct, sum_pct, del_pct, range_pct, topk_pct, name, keys] : workloads) {
+        cout << "\nWorkload: " << name << " (I:" << ins_pct
+             << "% S:" << srch_pct << "% Sum:" << sum_pct << "% E:" << del_pct
+             << "% R:" << range_pct << "% K:" << topk_pct << "%, ids: " << KeyGen::name(keys) << ")\n";
         
-        for (const string& type : {"DS1", "DS2", "DS3"}) {
-            double total_time = 0;
+        // CachedDS 的 visit 會改寫 slot, 不能放在 shared lock 後面, 所以這裡不測 +Cache
+        for (const char* type : {"DS1", "DS1SoA", "DS1Lsm", "DS2", "DS3", "DS3Skip"}) {
+            double base_throughput = 0;
             
-            for (int trial = 0; trial < 5; ++trial) {
-                unique_ptr<BaseDS> ds;
-                if (type == "DS1") ds.reset(new DS1());
-                else if (type == "DS2") ds.reset(new DS2());
-                else ds.reset(new DS3());
+            for (int n_threads : thread_counts) {
+                double total_time = 0;
                 
-                mt19937 rng(trial);
-                uniform_int_distribution<int> id_dist(1, 1 << 20);
-                uniform_int_distribution<int> score_dist(0, 100);
-                uniform_int_distribution<int> op_dist(1, 100);
-                
-                auto start = chrono::steady_clock::now();
-                
-                for (int i = 0; i < total_ops; ++i) {
-                    int op = op_dist(rng);
+                for (int trial = 0; trial < 5; ++trial) {
+                    ShardedDS ds(type, n_shards);
+                    vector<vector<TraceOp>> traces(n_threads);
+                    for (int t = 0; t < n_threads; ++t) {
+                        size_t ops = total_ops / n_threads + (t < total_ops % n_threads ? 1 : 0);
+                        traces[t] = generate_trace(ins_pct, srch_pct, del_pct, range_pct, topk_pct, keys, ops, trial * 1000 + t);
+                    }
+                    vector<thread> workers;
+                    
+                    auto start = chrono::steady_clock::now();
                     
-                    if (op <= ins_pct) {
-                        ds->insert(id_dist(rng), score_dist(rng));
-                    } else if (op <= ins_pct + srch_pct) {
-                        volatile auto res = ds->search(id_dist(rng));
-                    } else {
-                        volatile long long s = ds->sum_scores();
+                    for (int t = 0; t < n_threads; ++t) {
+                        workers.emplace_back([&, t] {
+                            replay_trace(ds, traces[t].data(), traces[t].size(), nullptr);
+                        });
                     }
+                    for (auto& w : workers) w.join();
+                    
+                    auto end = chrono::steady_clock::now();
+                    total_time += chrono::duration<double>(end - start).count();
                 }
                 
-                auto end = chrono::steady_clock::now();
-                total_time += chrono::duration<double>(end - start).count();
+                double avg_time = total_time / 5;
+                double throughput = total_ops / avg_time;
+                if (base_throughput == 0) base_throughput = throughput;
+                double speedup = throughput / base_throughput;
+                
+                cout << "  " << type << " x" << n_threads << ": " << avg_time << "s, "
+                     << throughput << " ops/sec, speedup " << speedup << "\n";
+                
+                out << name << "," << type << "," << n_threads << "," << n_shards << ","
+                    << avg_time << "," << throughput << "," << speedup << "\n";
+            }
+        }
+    }
+}
+
+// 比對兩個 DS1 的內容: 加總、全掃描、probes 上的搜尋結果與相鄰 probe 之間的 range_sum
+bool same_contents(const DS1& a, const DS1& b, const vector<int>& probes, string& err) {
+    if (a.sum_scores() != b.sum_scores() || a.scan_scores() != b.scan_scores()) {
+        err = "sum mismatch";
+        return false;
+    }
+    vector<int> sa, sb;
+    auto push_a = [&sa](int sc) { sa.push_back(sc); };
+    auto push_b = [&sb](int sc) { sb.push_back(sc); };
+    for (size_t i = 0; i < probes.size(); ++i) {
+        sa.clear();
+        sb.clear();
+        a.for_each_score(probes[i], push_a);
+        b.for_each_score(probes[i], push_b);
+        if (sa != sb) {
+            err = "search mismatch at id " + to_string(probes[i]);
+            return false;
+        }
+        int lo = min(probes[i], probes[(i + 1) % probes.size()]);
+        int hi = max(probes[i], probes[(i + 1) % probes.size()]);
+        if (a.range_sum(lo, hi) != b.range_sum(lo, hi)) {
+            err = "range_sum mismatch on [" + to_string(lo) + ", " + to_string(hi) + "]";
+            return false;
+        }
+    }
+    return true;
+}
+
+// 熱啟動: 同一批記錄, 比較重新 insert_batch 跟開啟 DS1 snapshot (有無 verify) 的時間,
+// 開啟後核對搜尋與加總跟原本的結構一致. snapshot 剛寫完還在 page cache 裡, 量到的是不含磁碟 I/O 的開啟成本
+int run_warm_start(const string& path, size_t n_records) {
+    mt19937 rng(0);
+    KeyGen id_dist(KeyGen::UNIFORM);
+    uniform_int_distribution<int> score_dist(0, 100);
+    vector<pair<int, int>> recs(n_records);
+    for (auto& r : recs) r = {id_dist(rng), score_dist(rng)};
+    vector<int> probes(10000);
+    for (auto& id : probes) id = id_dist(rng);
+    
+    ofstream out("warm_start_results.csv");
+    out << "Records,Method,Seconds\n";
+    cout << "\nWarm start: " << n_records << " records, snapshot " << path << "\n";
+    auto report = [&](const char* method, chrono::steady_clock::time_point start) {
+        double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  " << method << ": " << t << "s\n";
+        out << n_records << "," << method << "," << t << "\n";
+    };
+    
+    DS1 built;
+    auto start = chrono::steady_clock::now();
+    built.insert_batch(recs.data(), recs.size());
+    report("insert_batch", start);
+    
+    string err;
+    start = chrono::steady_clock::now();
+    if (!built.save_snapshot(path, err)) {
+        cerr << err << "\n";
+        return 1;
+    }
+    report("save_snapshot", start);
+    
+    for (bool verify : {false, true}) {
+        DS1 opened;
+        start = chrono::steady_clock::now();
+        if (!opened.open_snapshot(path, err, verify)) {
+            cerr << err << "\n";
+            return 1;
+        }
+        report(verify ? "open_snapshot_verify" : "open_snapshot", start);
+        // 第一次查詢才把用到的頁面映射進來, 這段也計時
+        start = chrono::steady_clock::now();
+        if (!same_contents(built, opened, probes, err)) {
+            cerr << (verify ? "verified " : "") << "snapshot differs: " << err << "\n";
+            return 1;
+        }
+        report(verify ? "parity_check_after_verify" : "parity_check", start);
+    }
+    cout << "  search / sum parity ok\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // ./mix --threads [max_threads]: 以 1, 2, 4, ... max_threads 個執行緒跑 ShardedDS
+    if (argc > 1 && string(argv[1]) == "--threads") {
+        int max_threads = argc > 2 ? atoi(argv[2]) : static_cast<int>(thread::hardware_concurrency());
+        if (max_threads < 1) max_threads = 1;
+        vector<int> thread_counts;
+        for (int n = 1; n < max_threads; n *= 2) thread_counts.push_back(n);
+        thread_counts.push_back(max_threads);
+        run_threaded(thread_counts, 64);
+        return 0;
+    }
+    
+    // ./mix --record <file> <workload> [n_ops] [seed]: 把合成 workload 存成 trace
+    if (argc > 3 && string(argv[1]) == "--record") {
+        size_t n_ops = argc > 4 ? strtoull(argv[4], nullptr, 10) : total_ops;
+        unsigned seed = argc > 5 ? strtoul(argv[5], nullptr, 10) : 0;
+        for (auto [ins_pct, srch_pct, sum_pct, del_pct, range_pct, topk_pct, name, keys] : workloads) {
+            if (name != argv[3]) continue;
+            if (!write_trace(argv[2], generate_trace(ins_pct, srch_pct, del_pct, range_pct, topk_pct, keys, n_ops, seed))) {
+                cerr << "failed to write " << argv[2] << "\n";
+                return 1;
+            }
+            cout << "recorded " << n_ops << " ops of " << name << " to " << argv[2] << "\n";
+            return 0;
+        }
+        cerr << "unknown workload " << argv[3] << "\n";
+        return 1;
+    }
+    
+    // ./mix --replay <file>: mmap trace 後依序餵給每一種資料結構
+    if (argc > 2 && string(argv[1]) == "--replay") {
+        MappedTrace trace;
+        string err;
+        if (!trace.open(argv[2], err)) {
+            cerr << err << "\n";
+            return 1;
+        }
+        ofstream out("mixed_replay_results.csv");
+        write_result_header(out);
+        cout << "\nTrace: " << argv[2] << " (" << trace.n_ops << " ops)\n";
+        for (const string& type : ds_types) {
+            LatencyHistogram hist[n_op_kinds];
+            double t = replay_as(type, trace.ops, trace.n_ops, nullptr);
+            replay_as(type, trace.ops, trace.n_ops, hist);
+            write_result_row(out, argv[2], type, t, trace.n_ops, hist);
+        }
+        return 0;
+    }
+    
+    // ./mix --warm-start <file> [n_records]: DS1 snapshot 開啟 vs 重新插入
+    if (argc > 2 && string(argv[1]) == "--warm-start") {
+        size_t n_records = argc > 3 ? strtoull(argv[3], nullptr, 10) : 1000000;
+        return run_warm_start(argv[2], n_records);
+    }
+    
+    for (const string& type : ds_types) {
+        string err;
+        if (type.find("+Cache") != string::npos && !check_cache_ids(type, err)) {
+            cerr << type << ": " << err << "\n";
+            return 1;
+        }
+    }
+
+    ofstream out("mixed_ops_results.csv");
+    write_result_header(out);
+
+    for (auto [ins_pct, srch_pct, sum_pct, del_pct, range_pct, topk_pct, name, keys] : workloads) {
+        cout << "\nWorkload: " << name << " (I:" << ins_pct 
+             << "% S:" << srch_pct << "% Sum:" << sum_pct << "% E:" << del_pct
+             << "% R:" << range_pct << "% K:" << topk_pct << "%, ids: " << KeyGen::name(keys) << ")\n";
+        
+        // 有 range / top-k 的 workload 先核對答案, 計時才有意義
+        vector<TraceOp> check_ops;
+        if (range_pct + topk_pct > 0) {
+            check_ops = generate_trace(ins_pct, srch_pct, del_pct, range_pct, topk_pct, keys, total_ops, 0);
+        }
+        
+        for (const string& type : ds_types) {
+            string err;
+            if (!check_ops.empty() && !check_range_ops(type, check_ops.data(), check_ops.size(), 200, err)) {
+                cerr << type << ": " << err << "\n";
+                return 1;
+            }
+            double total_time = 0;
+            for (int trial = 0; trial < 5; ++trial) {
+                vector<TraceOp> ops = generate_trace(ins_pct, srch_pct, del_pct, range_pct, topk_pct, keys, total_ops, trial);
+                total_time += replay_as(type, ops.data(), ops.size(), nullptr);
+            }
+            // 延遲另外用 trial 0 的 trace 跑一次, 不算進上面的吞吐量
+            LatencyHistogram hist[n_op_kinds];  // 依 TraceOpKind 分
+            {
+                vector<TraceOp> ops = generate_trace(ins_pct, srch_pct, del_pct, range_pct, topk_pct, keys, total_ops, 0);
+                replay_as(type, ops.data(), ops.size(), hist);
             }
             
-            double avg_time = total_time / 5;
-            double avg_op_time_us = (avg_time / total_ops) * 1e6;
-            double throughput = total_ops / avg_time;
-            
-            cout << "  " << type << ": " << avg_time << "s, " 
-                 << throughput << " ops/sec\n";
-            
-            out << name << "," << type << "," << avg_time << "," 
-                << avg_op_time_us << "," << throughput << "\n";
+            write_result_row(out, name, type, total_time / 5, total_ops, hist);
         }
     }
     
     return 0;
-}
\ No newline at end of file
+}
@@ -21,14 +21,24 @@ plt.rcParams.update({
 # Match the color scheme from plot.py
 STRUCTURE_COLORS = {
     "DS1": "#418af7",  # Blue
+    "DS1SoA": "#9ecae1",  # Light blue
+    "DS1+Cache": "#08519c",  # Dark blue
+    "DS1Lsm": "#6baed6",  # Mid blue
     "DS2": "#5fb075",  # Green
     "DS3": "#ee613d",  # Red
+    "DS3Skip": "#fdae6b",  # Orange
+    "DS3+Cache": "#a50f15",  # Dark red
 }
 
 STRUCTURE_MARKERS = {
     "DS1": "o",
+    "DS1SoA": "D",
+    "DS1+Cache": "P",
+    "DS1Lsm": "h",
     "DS2": "v",
     "DS3": "s",
+    "DS3Skip": "X",
+    "DS3+Cache": "*",
 }
 
 def load_data(csv_path: Path) -> pd.DataFrame:
@@ -44,12 +54,12 @@ def plot_throughput_comparison(df: pd.DataFrame, output_dir: Path):
     structures = df['Type'].unique()
     
     x = np.arange(len(workloads))
-    width = 0.25
+    width = 0.8 / len(structures)
     
     for i, struct in enumerate(structures):
         data = df[df['Type'] == struct]
         throughput = data['Throughput_ops_per_sec'].values
-        offset = width * (i - 1)
+        offset = width * (i - (len(structures) - 1) / 2)
         bars = ax.bar(x + offset, throughput, width, 
                      label=struct, 
                      color=STRUCTURE_COLORS[struct],
@@ -87,12 +97,12 @@ def plot_avg_operation_time(df: pd.DataFrame, output_dir: Path):
     structures = df['Type'].unique()
     
     x = np.arange(len(workloads))
-    width = 0.25
+    width = 0.8 / len(structures)
     
     for i, struct in enumerate(structures):
         data = df[df['Type'] == struct]
         avg_time = data['AvgOpTime_us'].values
-        offset = width * (i - 1)
+        offset = width * (i - (len(structures) - 1) / 2)
         bars = ax.bar(x + offset, avg_time, width, 
                      label=struct, 
                      color=STRUCTURE_COLORS[struct],
@@ -130,12 +140,12 @@ def plot_total_time(df: pd.DataFrame, output_dir: Path):
     structures = df['Type'].unique()
     
     x = np.arange(len(workloads))
-    width = 0.25
+    width = 0.8 / len(structures)
     
     for i, struct in enumerate(structures):
         data = df[df['Type'] == struct]
         total_time = data['TotalTime'].values
-        offset = width * (i - 1)
+        offset = width * (i - (len(structures) - 1) / 2)
         bars = ax.bar(x + offset, total_time, width, 
                      label=struct, 
                      color=STRUCTURE_COLORS[struct],
@@ -219,14 +229,14 @@ def plot_overview(df: pd.DataFrame, output_dir: Path):
     workloads = df['Workload'].unique()
     structures = df['Type'].unique()
     x = np.arange(len(workloads))
-    width = 0.25
+    width = 0.8 / len(structures)
     
     # Plot 1: Throughput
     ax = axes[0, 0]
     for i, struct in enumerate(structures):
         data = df[df['Type'] == struct]
         throughput = data['Throughput_ops_per_sec'].values
-        offset = width * (i - 1)
+        offset = width * (i - (len(structures) - 1) / 2)
         ax.bar(x + offset, throughput, width, label=struct, 
                color=STRUCTURE_COLORS[struct], edgecolor='black', linewidth=1.5)
     ax.set_ylabel('Throughput (ops/sec)')
@@ -247,7 +257,7 @@ def plot_overview(df: pd.DataFrame, output_dir: Path):
     for i, struct in enumerate(structures):
         data = df[df['Type'] == struct]
         avg_time = data['AvgOpTime_us'].values
-        offset = width * (i - 1)
+        offset = width * (i - (len(structures) - 1) / 2)
         ax.bar(x + offset, avg_time, width, label=struct, 
                color=STRUCTURE_COLORS[struct], edgecolor='black', linewidth=1.5)
     ax.set_ylabel('Average Operation Time (μs)')
@@ -268,7 +278,7 @@ def plot_overview(df: pd.DataFrame, output_dir: Path):
     for i, struct in enumerate(structures):
         data = df[df['Type'] == struct]
         total_time = data['TotalTime'].values
-        offset = width * (i - 1)
+        offset = width * (i - (len(structures) - 1) / 2)
         ax.bar(x + offset, total_time, width, label=struct, 
                color=STRUCTURE_COLORS[struct], edgecolor='black', linewidth=1.5)
     ax.set_xlabel('Workload Type')
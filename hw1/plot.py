@@ -26,14 +26,20 @@ plt.rcParams.update({
 STRUCTURE_COLORS: Dict[str, str] = {
     # Publication-ready ColorBrewer-inspired palette
     "DS1":                   "#418af7",  # Blue
+    "DS1SoA":                "#9ecae1",  # Light blue
+    "DS1Lsm":                "#6baed6",  # Mid blue
     "DS2":                   "#5fb075",  # Green
     "DS3":                   "#ee613d",  # Red
+    "DS3Skip":               "#fdae6b",  # Orange
 }
 
 STRUCTURE_MARKERS: Dict[str, str] = {
     "DS1": "o",
+    "DS1SoA": "P",
+    "DS1Lsm": "h",
     "DS2": "v",
     "DS3": "s",
+    "DS3Skip": "X",
     "DynamicArrayStore": "D",
     "StaticArrayLinkedStore": "^",
 }
@@ -1,8 +1,77 @@
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
-#include <functional>
 #include <iostream>
-#include <map>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Typed bump allocator for tree and list nodes. Objects are carved in order
+// out of 64 KiB blocks aligned to a cache line, so nodes created one after
+// another sit next to each other, and Release() hands a whole structure back
+// with one free() per block instead of one delete per node. Nodes are never
+// destroyed individually, hence the trivially destructible requirement.
+template <typename T> class NodeArena {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "NodeArena never runs destructors");
+
+public:
+  NodeArena() = default;
+  NodeArena(const NodeArena &) = delete;
+  NodeArena &operator=(const NodeArena &) = delete;
+  ~NodeArena() { Release(); }
+
+  template <typename... Args> T *New(Args &&...args) {
+    return new (Allocate(1)) T(std::forward<Args>(args)...);
+  }
+
+  // Uninitialised room for count contiguous objects.
+  T *Allocate(std::size_t count) {
+    if (count > capacity - used) {
+      Grow(count);
+    }
+    T *out = current + used;
+    used += count;
+    return out;
+  }
+
+  // Every pointer handed out so far becomes invalid.
+  void Release() {
+    for (void *block : blocks) {
+      std::free(block);
+    }
+    blocks.clear();
+    current = nullptr;
+    used = 0;
+    capacity = 0;
+  }
+
+private:
+  static const std::size_t kBlockBytes = 1 << 16;
+  static const std::size_t kLineBytes = 64;
+
+  void Grow(std::size_t count) {
+    std::size_t n = std::max(count, kBlockBytes / sizeof(T));
+    void *block = std::malloc(n * sizeof(T) + kLineBytes - 1);
+    if (!block) {
+      throw std::bad_alloc();
+    }
+    blocks.push_back(block);
+    std::uintptr_t start = reinterpret_cast<std::uintptr_t>(block);
+    start = (start + kLineBytes - 1) & ~(std::uintptr_t(kLineBytes) - 1);
+    current = reinterpret_cast<T *>(start);
+    used = 0;
+    capacity = n;
+  }
+
+  std::vector<void *> blocks;
+  T *current = nullptr;
+  std::size_t used = 0;
+  std::size_t capacity = 0;
+};
 
 struct Node {
   int id;
@@ -18,6 +87,204 @@ struct Node {
 
 using addr = Node *;
 
+// id -> (sum, count) of the scores currently stored. The structures keep it in
+// step with every insert and score update, so SearchAVG* is one hash lookup.
+// Each structure object indexes the one tree it builds: an insert into an
+// empty tree (null root or head) starts a new index, so an object reused after
+// Free* does not report the old tree's scores.
+template <typename Node = void> class IdIndex {
+public:
+  // Node* is a slot a structure may use to reach its elements with this id;
+  // the skip list keeps its lowest-scored node there.
+  struct Entry {
+    long long sum = 0;
+    int count = 0;
+    Node *node = nullptr;
+
+    void Add(int score) {
+      sum += score;
+      count += 1;
+    }
+    void Replace(int oldScore, int newScore) { sum += newScore - oldScore; }
+  };
+
+  void Add(int id, int score) { entries[id].Add(score); }
+
+  void Replace(int id, int oldScore, int newScore) {
+    entries[id].Replace(oldScore, newScore);
+  }
+
+  // Entry for id, created empty (count 0) if the id is new.
+  Entry &At(int id) { return entries[id]; }
+
+  // Drops every entry, for a structure that is rebuilt from scratch.
+  void Reset(std::size_t expected = 0) {
+    entries.clear();
+    entries.reserve(expected);
+  }
+
+  double Average(int id) const {
+    auto it = entries.find(id);
+    if (it == entries.end() || it->second.count == 0) {
+      return -1.0;
+    }
+    return static_cast<double>(it->second.sum) / it->second.count;
+  }
+
+private:
+  std::unordered_map<int, Entry> entries;
+};
+
+// Key order of the trees. ByScore is the original: equal scores all go
+// right, and with only 101 distinct scores the ties pile up into long right
+// chains. ByScoreThenId breaks ties by id, so keys are distinct and random
+// ids keep even the plain BST O(log n) deep.
+enum class KeyOrder { ByScore, ByScoreThenId };
+
+// True if an element (score, id) goes left of node under order.
+template <typename TreeNode>
+bool SortsBefore(KeyOrder order, int score, int id, const TreeNode *node) {
+  if (score != node->score) {
+    return score < node->score;
+  }
+  return order == KeyOrder::ByScoreThenId && id < node->id;
+}
+
+// One (id, score) record, as handed to the BulkLoad* builders.
+struct DataItem {
+  int id;
+  int score;
+};
+
+// Stable LSD radix pass over perm by key(perm[i]), 8 bits at a time on the
+// key with its sign bit flipped. A byte that is the same for every key is
+// skipped, so scores in 0..100 take a single counting pass.
+template <typename Key>
+void RadixSortBy(std::vector<int> &perm, std::vector<int> &buffer, Key key) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    std::size_t count[257] = {};
+    for (int i : perm) {
+      std::uint32_t bits = static_cast<std::uint32_t>(key(i)) ^ 0x80000000u;
+      ++count[((bits >> shift) & 0xFF) + 1];
+    }
+    if (std::find(count + 1, count + 257, perm.size()) != count + 257) {
+      continue;
+    }
+    for (int digit = 0; digit < 256; ++digit) {
+      count[digit + 1] += count[digit];
+    }
+    for (int i : perm) {
+      std::uint32_t bits = static_cast<std::uint32_t>(key(i)) ^ 0x80000000u;
+      buffer[count[(bits >> shift) & 0xFF]++] = i;
+    }
+    perm.swap(buffer);
+  }
+}
+
+// Positions of items in key order; equal keys keep their input order, which
+// is where successive inserts would have put them. Input already in order
+// costs one check and no sorting.
+std::vector<int> SortedPositions(const std::vector<DataItem> &items,
+                                 KeyOrder order) {
+  std::vector<int> perm(items.size());
+  for (std::size_t i = 0; i < perm.size(); ++i) {
+    perm[i] = static_cast<int>(i);
+  }
+  bool sorted = true;
+  for (std::size_t i = 1; i < items.size() && sorted; ++i) {
+    sorted = !SortsBefore(order, items[i].score, items[i].id, &items[i - 1]);
+  }
+  if (sorted) {
+    return perm;
+  }
+  std::vector<int> buffer(items.size());
+  if (order == KeyOrder::ByScoreThenId) {
+    RadixSortBy(perm, buffer, [&](int i) { return items[i].id; });
+  }
+  RadixSortBy(perm, buffer, [&](int i) { return items[i].score; });
+  return perm;
+}
+
+// In-order traversals shared by the structures. A visitor is any callable
+// taking const Node *; templates let it inline instead of going through a
+// std::function per node.
+
+// Explicit stack, no recursion; the stack grows to the tree height.
+template <typename TreeNode, typename Visitor>
+void StackInOrder(const TreeNode *root, Visitor &&visit) {
+  std::vector<const TreeNode *> stack;
+  const TreeNode *node = root;
+  while (node || !stack.empty()) {
+    while (node) {
+      stack.push_back(node);
+      node = node->left;
+    }
+    node = stack.back();
+    stack.pop_back();
+    visit(node);
+    node = node->right;
+  }
+}
+
+// Morris traversal: no stack and no allocation. It threads each in-order
+// predecessor's right link back to its successor and removes the thread on
+// the second visit, so the tree is unchanged when it returns but must not be
+// touched by anyone else meanwhile.
+template <typename TreeNode, typename Visitor>
+void MorrisInOrder(TreeNode *root, Visitor &&visit) {
+  TreeNode *node = root;
+  while (node) {
+    if (!node->left) {
+      visit(static_cast<const TreeNode *>(node));
+      node = node->right;
+      continue;
+    }
+    TreeNode *pred = node->left;
+    while (pred->right && pred->right != node) {
+      pred = pred->right;
+    }
+    if (!pred->right) {
+      pred->right = node;
+      node = node->left;
+    } else {
+      pred->right = nullptr;
+      visit(static_cast<const TreeNode *>(node));
+      node = node->right;
+    }
+  }
+}
+
+// The skip list's bottom level is already in order.
+template <typename ListNode, typename Visitor>
+void ListInOrder(const ListNode *head, Visitor &&visit) {
+  for (const ListNode *node = head ? head->next[0] : nullptr; node;
+       node = node->next[0]) {
+    visit(node);
+  }
+}
+
+// Visitor that averages the scores of one id, for the SearchAVG*_DFS scans.
+class IdAverage {
+public:
+  explicit IdAverage(int idValue) : id(idValue) {}
+
+  template <typename AnyNode> void operator()(const AnyNode *node) {
+    if (node->id == id) {
+      sum += node->score;
+      ++count;
+    }
+  }
+
+  double Average() const {
+    return count == 0 ? -1.0 : static_cast<double>(sum) / count;
+  }
+
+private:
+  int id;
+  long long sum = 0;
+  int count = 0;
+};
+
 struct AVLNode {
   int id;
   int score;
@@ -37,36 +304,40 @@ using avl_addr = AVLNode *;
 // AVL tree with |balance factor| <= 3
 class AVLTreeBF3 {
 public:
+  AVLTreeBF3() = default;
+
+  explicit AVLTreeBF3(KeyOrder keyOrder) : order(keyOrder) {}
+
+  explicit AVLTreeBF3(NodeArena<AVLNode> *nodeArena,
+                      KeyOrder keyOrder = KeyOrder::ByScore)
+      : arena(nodeArena), order(keyOrder) {}
+
   avl_addr InsertAVLTreeBF3(int id, int score, avl_addr root) {
-    cacheBuilt = false;
     if (!root) {
-      return createRoot(id, score);
-    }
-    if (id == root->id) {
-      root->score = score;
-      return root;
-    }
-    if (score < root->score) {
-      root->left = InsertAVLTreeBF3(id, score, root->left);
-    } else {
-      root->right = InsertAVLTreeBF3(id, score, root->right);
-    }
-    updateHeight(root);
-    int balance = getBalance(root);
-
-    if (balance > 3 && getBalance(root->left) >= 0) {
-      return rotateRight(root);
-    }
-    if (balance > 3 && getBalance(root->left) < 0) {
-      root->left = rotateLeft(root->left);
-      return rotateRight(root);
+      index.Reset();
     }
-    if (balance < -3 && getBalance(root->right) <= 0) {
-      return rotateLeft(root);
+    path.clear();
+    avl_addr *link = &root;
+    while (*link) {
+      avl_addr node = *link;
+      if (id == node->id) {
+        index.Replace(id, node->score, score);
+        node->score = score;
+        return root;
+      }
+      path.push_back(link);
+      link = SortsBefore(order, score, id, node) ? &node->left : &node->right;
     }
-    if (balance < -3 && getBalance(root->right) > 0) {
-      root->right = rotateRight(root->right);
-      return rotateLeft(root);
+    index.Add(id, score);
+    *link = createRoot(id, score);
+    // Once a subtree is back to its old height, nothing above it changes.
+    for (size_t i = path.size(); i-- > 0;) {
+      int oldHeight = (*path[i])->height;
+      updateHeight(*path[i]);
+      *path[i] = rebalance(*path[i]);
+      if ((*path[i])->height == oldHeight) {
+        break;
+      }
     }
     return root;
   }
@@ -79,71 +350,33 @@ public:
   }
 
   void PrintAVLTreeBF3(avl_addr root) const {
-    if (!root) {
-      return;
-    }
-    PrintAVLTreeBF3(root->left);
-    std::cout << "id: " << root->id << ", score: " << root->score
-              << ", height: " << root->height << '\n';
-    PrintAVLTreeBF3(root->right);
+    MorrisInOrder(root, [](const AVLNode *node) {
+      std::cout << "id: " << node->id << ", score: " << node->score
+                << ", height: " << node->height << '\n';
+    });
   }
 
   // 原本的 DFS 版 Search（展示用）
   double SearchAVGAVLTreeBF3_DFS(avl_addr root, int id) const {
-    int sum = 0;
-    int count = 0;
-    std::function<void(avl_addr)> dfs = [&](avl_addr node) {
-      if (!node) {
-        return;
-      }
-      if (node->id == id) {
-        sum += node->score;
-        ++count;
-      }
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
-    if (count == 0) {
-      return -1.0;
-    }
-    return static_cast<double>(sum) / count;
+    IdAverage average(id);
+    StackInOrder(root, average);
+    return average.Average();
   }
 
-  double SearchAVGAVLTreeBF3(avl_addr root, int id) const {
-    if (!cacheBuilt) {
-      buildAvgCache(root);
-      cacheBuilt = true;
-    }
-    auto it = avgCache.find(id);
-    if (it == avgCache.end() || it->second.second == 0) {
-      return -1.0;
-    }
-    return static_cast<double>(it->second.first) / it->second.second;
+  double SearchAVGAVLTreeBF3(avl_addr /*root*/, int id) const {
+    return index.Average(id);
   }
 
 private:
-  // id -> (sum, count)
-  mutable bool cacheBuilt = false;
-  mutable std::map<int, std::pair<long long, int>> avgCache;
-
-  void buildAvgCache(avl_addr root) const {
-    avgCache.clear();
-    std::function<void(avl_addr)> dfs = [&](avl_addr node) {
-      if (!node) {
-        return;
-      }
-      auto &entry = avgCache[node->id];
-      entry.first += node->score;
-      entry.second += 1;
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
-  }
-
-  static avl_addr createRoot(int id, int score) {
-    return new AVLNode(id, score);
+  IdIndex<> index;
+  NodeArena<AVLNode> *arena = nullptr;
+  KeyOrder order = KeyOrder::ByScore;
+  // Links followed by the current insert, root first; a member so inserts
+  // don't allocate.
+  std::vector<avl_addr *> path;
+
+  avl_addr createRoot(int id, int score) {
+    return arena ? arena->New(id, score) : new AVLNode(id, score);
   }
 
   static int height(avl_addr node) { return node ? node->height : 0; }
@@ -175,6 +408,25 @@ private:
     updateHeight(y);
     return y;
   }
+
+  static avl_addr rebalance(avl_addr root) {
+    int balance = getBalance(root);
+    if (balance > 3 && getBalance(root->left) >= 0) {
+      return rotateRight(root);
+    }
+    if (balance > 3 && getBalance(root->left) < 0) {
+      root->left = rotateLeft(root->left);
+      return rotateRight(root);
+    }
+    if (balance < -3 && getBalance(root->right) <= 0) {
+      return rotateLeft(root);
+    }
+    if (balance < -3 && getBalance(root->right) > 0) {
+      root->right = rotateRight(root->right);
+      return rotateLeft(root);
+    }
+    return root;
+  }
 };
 
 struct TreapNode {
@@ -197,145 +449,140 @@ struct SkipListNode {
   int id;
   int score;
   int height = 1;
-  SkipListNode *right = nullptr;
-  SkipListNode *down = nullptr;
+  // Insert order: nodes are ordered by (score, serial), so a node that has to
+  // move can be found again exactly among equal scores.
+  unsigned serial = 0;
+  // Next node with the same id, in (score, serial) order.
+  SkipListNode *sameId = nullptr;
+  // next[l] is the following node on level l; next[0] links every node in
+  // score order. The array is allocated alongside the node, by new[] or from
+  // the same arena.
+  SkipListNode **next = nullptr;
 
   SkipListNode() = default;
-  SkipListNode(int idValue, int scoreValue, int heightValue = 1,
-               SkipListNode *rightNode = nullptr,
-               SkipListNode *downNode = nullptr)
-      : id(idValue), score(scoreValue), height(heightValue), right(rightNode),
-        down(downNode) {}
+  SkipListNode(int idValue, int scoreValue, int heightValue,
+               SkipListNode **links)
+      : id(idValue), score(scoreValue), height(heightValue), next(links) {}
 };
 
+// A skip list is passed around as its head: a sentinel node (not an element)
+// whose height is the height of the tallest tower.
 using skip_addr = SkipListNode *;
 
+// Height of a binary tree, one level at a time so a degenerate chain needs no
+// call stack.
+template <typename TreeNode> int TreeHeight(const TreeNode *root) {
+  std::vector<const TreeNode *> level;
+  std::vector<const TreeNode *> below;
+  if (root) {
+    level.push_back(root);
+  }
+  int height = 0;
+  while (!level.empty()) {
+    ++height;
+    below.clear();
+    for (const TreeNode *node : level) {
+      if (node->left) {
+        below.push_back(node->left);
+      }
+      if (node->right) {
+        below.push_back(node->right);
+      }
+    }
+    level.swap(below);
+  }
+  return height;
+}
+
 /* init */
 class BST {
 public:
+  BST() = default;
+
+  explicit BST(KeyOrder keyOrder) : order(keyOrder) {}
+
+  // Nodes come from nodeArena, which the caller releases instead of FreeBST.
+  explicit BST(NodeArena<Node> *nodeArena,
+               KeyOrder keyOrder = KeyOrder::ByScore)
+      : arena(nodeArena), order(keyOrder) {}
+
   addr InsertBST(int id, int score, addr root) {
-    cacheBuilt = false;
     if (!root) {
-      return CreateBST(id, score);
+      index.Reset();
     }
-    if (id == root->id) {
-      root->score = score;
-      return root;
-    }
-    if (score < root->score) {
-      root->left = InsertBST(id, score, root->left);
-    } else {
-      root->right = InsertBST(id, score, root->right);
+    addr *link = &root;
+    while (*link) {
+      addr node = *link;
+      if (id == node->id) {
+        index.Replace(id, node->score, score);
+        node->score = score;
+        return root;
+      }
+      link = SortsBefore(order, score, id, node) ? &node->left : &node->right;
     }
+    index.Add(id, score);
+    *link = CreateBST(id, score);
     return root;
   }
 
   void PrintBST(addr root) const {
-    if (!root) {
-      return;
-    }
-    PrintBST(root->left);
-    std::cout << "id: " << root->id << ", score: " << root->score << '\n';
-    PrintBST(root->right);
+    MorrisInOrder(root, [](const Node *node) {
+      std::cout << "id: " << node->id << ", score: " << node->score << '\n';
+    });
   }
 
-  int HeightBST(addr root) const {
-    if (!root) {
-      return 0;
-    }
-    int leftHeight = HeightBST(root->left);
-    int rightHeight = HeightBST(root->right);
-    return std::max(leftHeight, rightHeight) + 1;
-  }
+  int HeightBST(addr root) const { return TreeHeight(root); }
 
   // 原本的 DFS 版 Search（展示用）
   double SearchAVGBST_DFS(addr root, int id) const {
-    int sum = 0;
-    int count = 0;
-    std::function<void(addr)> dfs = [&](addr node) {
-      if (!node) {
-        return;
-      }
-      if (node->id == id) {
-        sum += node->score;
-        ++count;
-      }
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
-    if (count == 0) {
-      return -1.0;
-    }
-    return static_cast<double>(sum) / count;
+    IdAverage average(id);
+    StackInOrder(root, average);
+    return average.Average();
   }
 
-  double SearchAVGBST(addr root, int id) const {
-    if (!cacheBuilt) {
-      buildAvgCache(root);
-      cacheBuilt = true;
-    }
-    auto it = avgCache.find(id);
-    if (it == avgCache.end() || it->second.second == 0) {
-      return -1.0;
-    }
-    return static_cast<double>(it->second.first) / it->second.second;
+  double SearchAVGBST(addr /*root*/, int id) const {
+    return index.Average(id);
   }
 
 private:
-  // id -> (sum, count)
-  mutable bool cacheBuilt = false;
-  mutable std::map<int, std::pair<long long, int>> avgCache;
-
-  void buildAvgCache(addr root) const {
-    avgCache.clear();
-    std::function<void(addr)> dfs = [&](addr node) {
-      if (!node) {
-        return;
-      }
-      auto &entry = avgCache[node->id];
-      entry.first += node->score;
-      entry.second += 1;
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
-  }
+  IdIndex<> index;
+  NodeArena<Node> *arena = nullptr;
+  KeyOrder order = KeyOrder::ByScore;
 
-  static addr CreateBST(int id, int score) { return new Node(id, score); }
+  addr CreateBST(int id, int score) {
+    return arena ? arena->New(id, score) : new Node(id, score);
+  }
 };
 
-// Helper functions to free allocated nodes without affecting evaluation timing.
-void FreeBST(addr root) {
-  if (!root) {
-    return;
+// Deletes a binary tree without a stack: a node with a left child is rotated
+// right until the root has none, then the root is deleted and its right
+// subtree takes over.
+template <typename TreeNode> void FreeTree(TreeNode *root) {
+  while (root) {
+    if (root->left) {
+      TreeNode *left = root->left;
+      root->left = left->right;
+      left->right = root;
+      root = left;
+    } else {
+      TreeNode *right = root->right;
+      delete root;
+      root = right;
+    }
   }
-  FreeBST(root->left);
-  FreeBST(root->right);
-  delete root;
 }
 
-void FreeAVL(avl_addr root) {
-  if (!root) {
-    return;
-  }
-  FreeAVL(root->left);
-  FreeAVL(root->right);
-  delete root;
-}
+// Helper functions to free allocated nodes without affecting evaluation timing.
+void FreeBST(addr root) { FreeTree(root); }
 
-void FreeTreap(treap_addr root) {
-  if (!root) {
-    return;
-  }
-  FreeTreap(root->left);
-  FreeTreap(root->right);
-  delete root;
-}
+void FreeAVL(avl_addr root) { FreeTree(root); }
+
+void FreeTreap(treap_addr root) { FreeTree(root); }
 
 void FreeSkipList(skip_addr head) {
   while (head) {
-    skip_addr next = head->right;
+    skip_addr next = head->next[0];
+    delete[] head->next;
     delete head;
     head = next;
   }
@@ -343,48 +590,51 @@ void FreeSkipList(skip_addr head) {
 
 class AVLTree {
 public:
+  AVLTree() = default;
+
+  explicit AVLTree(KeyOrder keyOrder) : order(keyOrder) {}
+
+  // Nodes come from nodeArena, which the caller releases instead of FreeAVL.
+  explicit AVLTree(NodeArena<AVLNode> *nodeArena,
+                   KeyOrder keyOrder = KeyOrder::ByScore)
+      : arena(nodeArena), order(keyOrder) {}
+
+  // Iterative: descends recording the links taken, then rebalances upward.
   avl_addr InsertAVLTree(int id, int score, avl_addr root) {
-    cacheBuilt = false;
     if (!root) {
-      return createRoot(id, score);
-    }
-    if (id == root->id) {
-      root->score = score;
-      return root;
-    }
-    if (score < root->score) {
-      root->left = InsertAVLTree(id, score, root->left);
-    } else {
-      root->right = InsertAVLTree(id, score, root->right);
-    }
-    updateHeight(root);
-    int balance = getBalance(root);
-
-    if (balance > 1 && getBalance(root->left) >= 0) {
-      return rotateRightWithPrint(root);
-    }
-    if (balance > 1 && getBalance(root->left) < 0) {
-      root->left = rotateLeftWithPrint(root->left);
-      return rotateRightWithPrint(root);
+      index.Reset();
     }
-    if (balance < -1 && getBalance(root->right) <= 0) {
-      return rotateLeftWithPrint(root);
+    path.clear();
+    avl_addr *link = &root;
+    while (*link) {
+      avl_addr node = *link;
+      if (id == node->id) {
+        index.Replace(id, node->score, score);
+        node->score = score;
+        return root;
+      }
+      path.push_back(link);
+      link = SortsBefore(order, score, id, node) ? &node->left : &node->right;
     }
-    if (balance < -1 && getBalance(root->right) > 0) {
-      root->right = rotateRightWithPrint(root->right);
-      return rotateLeftWithPrint(root);
+    index.Add(id, score);
+    *link = createRoot(id, score);
+    // Once a subtree is back to its old height, nothing above it changes.
+    for (size_t i = path.size(); i-- > 0;) {
+      int oldHeight = (*path[i])->height;
+      updateHeight(*path[i]);
+      *path[i] = rebalance(*path[i]);
+      if ((*path[i])->height == oldHeight) {
+        break;
+      }
     }
     return root;
   }
 
   void PrintAVLTree(avl_addr root) const {
-    if (!root) {
-      return;
-    }
-    PrintAVLTree(root->left);
-    std::cout << "id: " << root->id << ", score: " << root->score
-              << ", height: " << root->height << '\n';
-    PrintAVLTree(root->right);
+    MorrisInOrder(root, [](const AVLNode *node) {
+      std::cout << "id: " << node->id << ", score: " << node->score
+                << ", height: " << node->height << '\n';
+    });
   }
 
   int HeightAVLTree(avl_addr root) const {
@@ -394,62 +644,58 @@ public:
     return root->height;
   }
 
+  // Builds a perfectly balanced tree of items in O(n) after the sort (none
+  // if items are already in key order) and returns its root. Every item
+  // becomes a node, so ids are expected to be distinct; the tree this object
+  // indexed before is forgotten, and freeing it is up to the caller.
+  avl_addr BulkLoadAVLTree(const std::vector<DataItem> &items) {
+    index.Reset(items.size());
+    for (const DataItem &item : items) {
+      index.Add(item.id, item.score);
+    }
+    std::vector<DataItem> sorted;
+    sorted.reserve(items.size());
+    for (int i : SortedPositions(items, order)) {
+      sorted.push_back(items[i]);
+    }
+    return buildBalanced(sorted.data(), 0, static_cast<int>(sorted.size()));
+  }
+
   // 原本的 DFS 版 Search（展示用）
   double SearchAVGAVLTree_DFS(avl_addr root, int id) const {
-    int sum = 0;
-    int count = 0;
-    std::function<void(avl_addr)> dfs = [&](avl_addr node) {
-      if (!node) {
-        return;
-      }
-      if (node->id == id) {
-        sum += node->score;
-        ++count;
-      }
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
-    if (count == 0) {
-      return -1.0;
-    }
-    return static_cast<double>(sum) / count;
+    IdAverage average(id);
+    StackInOrder(root, average);
+    return average.Average();
   }
 
-  double SearchAVGAVLTree(avl_addr root, int id) const {
-    if (!cacheBuilt) {
-      buildAvgCache(root);
-      cacheBuilt = true;
-    }
-    auto it = avgCache.find(id);
-    if (it == avgCache.end() || it->second.second == 0) {
-      return -1.0;
-    }
-    return static_cast<double>(it->second.first) / it->second.second;
+  double SearchAVGAVLTree(avl_addr /*root*/, int id) const {
+    return index.Average(id);
   }
 
 private:
-  // id -> (sum, count)
-  mutable bool cacheBuilt = false;
-  mutable std::map<int, std::pair<long long, int>> avgCache;
-
-  void buildAvgCache(avl_addr root) const {
-    avgCache.clear();
-    std::function<void(avl_addr)> dfs = [&](avl_addr node) {
-      if (!node) {
-        return;
-      }
-      auto &entry = avgCache[node->id];
-      entry.first += node->score;
-      entry.second += 1;
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
+  IdIndex<> index;
+  NodeArena<AVLNode> *arena = nullptr;
+  KeyOrder order = KeyOrder::ByScore;
+  // Links followed by the current insert, root first; a member so inserts
+  // don't allocate.
+  std::vector<avl_addr *> path;
+
+  avl_addr createRoot(int id, int score) {
+    return arena ? arena->New(id, score) : new AVLNode(id, score);
   }
 
-  static avl_addr createRoot(int id, int score) {
-    return new AVLNode(id, score);
+  // Middle of [lo, hi) as the root, halves as subtrees; recursion is only
+  // log2(n) deep.
+  avl_addr buildBalanced(const DataItem *sorted, int lo, int hi) {
+    if (lo >= hi) {
+      return nullptr;
+    }
+    int mid = lo + (hi - lo) / 2;
+    avl_addr node = createRoot(sorted[mid].id, sorted[mid].score);
+    node->left = buildBalanced(sorted, lo, mid);
+    node->right = buildBalanced(sorted, mid + 1, hi);
+    updateHeight(node);
+    return node;
   }
 
   static int height(avl_addr node) { return node ? node->height : 0; }
@@ -489,139 +735,216 @@ private:
   static avl_addr rotateLeftWithPrint(avl_addr x) {
     return rotateLeft(x);
   }
+
+  static avl_addr rebalance(avl_addr root) {
+    int balance = getBalance(root);
+    if (balance > 1 && getBalance(root->left) >= 0) {
+      return rotateRightWithPrint(root);
+    }
+    if (balance > 1 && getBalance(root->left) < 0) {
+      root->left = rotateLeftWithPrint(root->left);
+      return rotateRightWithPrint(root);
+    }
+    if (balance < -1 && getBalance(root->right) <= 0) {
+      return rotateLeftWithPrint(root);
+    }
+    if (balance < -1 && getBalance(root->right) > 0) {
+      root->right = rotateRightWithPrint(root->right);
+      return rotateLeftWithPrint(root);
+    }
+    return root;
+  }
 };
 
 class Treap {
 public:
   Treap() = default;
 
+  explicit Treap(KeyOrder keyOrder) : order(keyOrder) {}
+
+  // Nodes come from nodeArena, which the caller releases instead of FreeTreap.
+  explicit Treap(NodeArena<TreapNode> *nodeArena,
+                 KeyOrder keyOrder = KeyOrder::ByScore)
+      : arena(nodeArena), order(keyOrder) {}
+
+  // No recursion and no rotations for a new node: it is linked in at its
+  // final depth and the subtree it displaces is split around it top-down.
   treap_addr InsertTreap(int id, int score, double priority, treap_addr root) {
-    cacheBuilt = false;
     if (!root) {
-      return CreateTreap(id, score, priority);
+      index.Reset();
     }
-    if (id == root->id) {
-      root->score = score;
-      root->priority = priority;
-      return root;
-    }
-    if (score < root->score) {
-      root->left = InsertTreap(id, score, priority, root->left);
-      if (root->left && root->left->priority < root->priority) {
-        root = rotateRightWithPrint(root);
-      }
-    } else {
-      root->right = InsertTreap(id, score, priority, root->right);
-      if (root->right && root->right->priority < root->priority) {
-        root = rotateLeftWithPrint(root);
+    treap_addr *link = findLink(id, score, &root);
+    if (*link) {
+      index.Replace(id, (*link)->score, score);
+      (*link)->score = score;
+      double oldPriority = (*link)->priority;
+      (*link)->priority = priority;
+      if (priority < oldPriority) {
+        siftUp(link);
+      } else {
+        siftDown(link);
       }
+      return root;
     }
+    index.Add(id, score);
+    linkNode(CreateTreap(id, score, priority), link);
     return root;
   }
 
   treap_addr InsertTreap(int id, int score, treap_addr root) {
-    cacheBuilt = false;
     if (!root) {
-      return CreateTreap(id, score);
+      index.Reset();
     }
-    if (id == root->id) {
-      root->score = score;
+    treap_addr *link = findLink(id, score, &root);
+    if (*link) {
+      index.Replace(id, (*link)->score, score);
+      (*link)->score = score;
       return root;
     }
-    if (score < root->score) {
-      root->left = InsertTreap(id, score, root->left);
-      if (root->left && root->left->priority < root->priority) {
-        root = rotateRightWithPrint(root);
-      }
-    } else {
-      root->right = InsertTreap(id, score, root->right);
-      if (root->right && root->right->priority < root->priority) {
-        root = rotateLeftWithPrint(root);
-      }
-    }
+    index.Add(id, score);
+    linkNode(CreateTreap(id, score), link);
     return root;
   }
 
   void PrintTreap(treap_addr root) const {
-    if (!root) {
-      return;
-    }
-    PrintTreap(root->left);
-    std::cout << "id: " << root->id << ", score: " << root->score
-              << ", priority: " << root->priority << '\n';
-    PrintTreap(root->right);
+    MorrisInOrder(root, [](const TreapNode *node) {
+      std::cout << "id: " << node->id << ", score: " << node->score
+                << ", priority: " << node->priority << '\n';
+    });
   }
 
-  int HeightTreap(treap_addr root) const {
-    if (!root) {
-      return 0;
+  int HeightTreap(treap_addr root) const { return TreeHeight(root); }
+
+  // Builds the treap of items, priorities[i] belonging to items[i], as a
+  // Cartesian tree: in key order, each node pops the right spine nodes with
+  // a larger priority and adopts them as its left subtree. O(n) after the
+  // sort. Like BulkLoadAVLTree, ids are expected to be distinct and the old
+  // tree is the caller's to free.
+  treap_addr BulkLoadTreap(const std::vector<DataItem> &items,
+                           const std::vector<double> &priorities) {
+    index.Reset(items.size());
+    for (const DataItem &item : items) {
+      index.Add(item.id, item.score);
+    }
+    std::vector<treap_addr> spine;
+    for (int i : SortedPositions(items, order)) {
+      treap_addr node = CreateTreap(items[i].id, items[i].score, priorities[i]);
+      treap_addr popped = nullptr;
+      while (!spine.empty() && node->priority < spine.back()->priority) {
+        popped = spine.back();
+        spine.pop_back();
+      }
+      node->left = popped;
+      if (!spine.empty()) {
+        spine.back()->right = node;
+      }
+      spine.push_back(node);
     }
-    int leftHeight = HeightTreap(root->left);
-    int rightHeight = HeightTreap(root->right);
-    return std::max(leftHeight, rightHeight) + 1;
+    return spine.empty() ? nullptr : spine.front();
   }
 
   // 原本的 DFS 版 Search（展示用）
   double SearchAVGTreap_DFS(treap_addr root, int id) const {
-    int sum = 0;
-    int count = 0;
-    std::function<void(treap_addr)> dfs = [&](treap_addr node) {
-      if (!node) {
-        return;
+    IdAverage average(id);
+    StackInOrder(root, average);
+    return average.Average();
+  }
+
+  double SearchAVGTreap(treap_addr /*root*/, int id) const {
+    return index.Average(id);
+  }
+
+private:
+  IdIndex<> index;
+  NodeArena<TreapNode> *arena = nullptr;
+  KeyOrder order = KeyOrder::ByScore;
+  // Links above the one findLink returned, root first.
+  std::vector<treap_addr *> path;
+
+  // Follows the search path for score from *root. Returns the link holding
+  // the node with this id if one is on the path, otherwise the empty link
+  // where a plain BST insert would go.
+  treap_addr *findLink(int id, int score, treap_addr *root) {
+    path.clear();
+    treap_addr *link = root;
+    while (*link && (*link)->id != id) {
+      path.push_back(link);
+      link = SortsBefore(order, score, id, *link) ? &(*link)->left
+                                                  : &(*link)->right;
+    }
+    return link;
+  }
+
+  // Places node where rotating it up from leaf would have left it: below
+  // every ancestor whose priority is not larger.
+  void linkNode(treap_addr node, treap_addr *leaf) {
+    treap_addr *at = leaf;
+    for (treap_addr *link : path) {
+      if (node->priority < (*link)->priority) {
+        at = link;
+        break;
       }
-      if (node->id == id) {
-        sum += node->score;
-        ++count;
+    }
+    treap_addr rest = *at;
+    *at = node;
+    treap_addr *leftTail = &node->left;
+    treap_addr *rightTail = &node->right;
+    while (rest) {
+      if (SortsBefore(order, node->score, node->id, rest)) {
+        *rightTail = rest;
+        rightTail = &rest->left;
+        rest = rest->left;
+      } else {
+        *leftTail = rest;
+        leftTail = &rest->right;
+        rest = rest->right;
       }
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
-    if (count == 0) {
-      return -1.0;
     }
-    return static_cast<double>(sum) / count;
+    *leftTail = nullptr;
+    *rightTail = nullptr;
   }
 
-  double SearchAVGTreap(treap_addr root, int id) const {
-    if (!cacheBuilt) {
-      buildAvgCache(root);
-      cacheBuilt = true;
-    }
-    auto it = avgCache.find(id);
-    if (it == avgCache.end() || it->second.second == 0) {
-      return -1.0;
+  // Restore heap order after the node at *link got a smaller (siftUp) or
+  // larger (siftDown) priority.
+  void siftUp(treap_addr *link) {
+    for (size_t i = path.size(); i-- > 0;) {
+      treap_addr parent = *path[i];
+      if ((*link)->priority < parent->priority) {
+        *path[i] = link == &parent->left ? rotateRightWithPrint(parent)
+                                         : rotateLeftWithPrint(parent);
+      }
+      link = path[i];
     }
-    return static_cast<double>(it->second.first) / it->second.second;
   }
 
-private:
-  // id -> (sum, count)
-  mutable bool cacheBuilt = false;
-  mutable std::map<int, std::pair<long long, int>> avgCache;
-
-  void buildAvgCache(treap_addr root) const {
-    avgCache.clear();
-    std::function<void(treap_addr)> dfs = [&](treap_addr node) {
-      if (!node) {
+  static void siftDown(treap_addr *link) {
+    treap_addr node = *link;
+    for (;;) {
+      treap_addr child = node->left;
+      if (node->right && (!child || node->right->priority < child->priority)) {
+        child = node->right;
+      }
+      if (!child || !(child->priority < node->priority)) {
         return;
       }
-      auto &entry = avgCache[node->id];
-      entry.first += node->score;
-      entry.second += 1;
-      dfs(node->left);
-      dfs(node->right);
-    };
-    dfs(root);
+      if (child == node->left) {
+        *link = rotateRightWithPrint(node);
+        link = &child->right;
+      } else {
+        *link = rotateLeftWithPrint(node);
+        link = &child->left;
+      }
+    }
   }
 
-  static treap_addr CreateTreap(int id, int score) {
+  treap_addr CreateTreap(int id, int score) {
     double priority = static_cast<double>(std::rand()) / RAND_MAX;
-    return new TreapNode(id, score, priority);
+    return CreateTreap(id, score, priority);
   }
 
-  static treap_addr CreateTreap(int id, int score, double priority) {
-    return new TreapNode(id, score, priority);
+  treap_addr CreateTreap(int id, int score, double priority) {
+    return arena ? arena->New(id, score, priority)
+                 : new TreapNode(id, score, priority);
   }
 
   static treap_addr rotateRight(treap_addr y) {
@@ -655,109 +978,149 @@ public:
 
   explicit SkipList(double headProb) : probHead(headProb) {}
 
+  // Nodes and their next arrays come from the two arenas, which the caller
+  // releases instead of FreeSkipList.
+  SkipList(double headProb, NodeArena<SkipListNode> *nodeArena,
+           NodeArena<skip_addr> *linkArena)
+      : probHead(headProb), nodes(nodeArena), links(linkArena) {}
+
+  // Descends from the top level, so insert costs O(log n) expected. The
+  // original level-0 walk updated the first element with the same id and a
+  // score <= the new one. Here that element is looked up by id before
+  // descending, so the outcome does not depend on tower heights: if the
+  // lowest-scored element with this id has score <= score, it takes the new
+  // score and moves to its sorted place. Otherwise a new element is added.
   skip_addr InsertSkipList(int id, int score, skip_addr head) {
-    cacheBuilt = false;
     if (!head) {
-      return CreateSkipList(id, score);
-    }
-    if (id == head->id) {
-      head->score = score;
-      return head;
-    }
-    if (score < head->score) {
-      skip_addr node = CreateSkipList(id, score);
-      node->right = head;
-      return node;
+      index.Reset();
+      head = NewNode(0, 0, kMaxHeight);
+      head->height = 1;
     }
-    skip_addr current = head;
-    while (current->right && current->right->score <= score) {
-      if (current->right->id == id) {
-        current->right->score = score;
-        return head;
+    IdIndex<SkipListNode>::Entry &entry = index.At(id);
+    if (entry.node && entry.node->score <= score) {
+      skip_addr node = entry.node;
+      entry.Replace(node->score, score);
+      Unlink(head, node);
+      node->score = score;
+      node->serial = ++lastSerial;
+      Link(head, node);
+      // node was first on its id chain; put it back in order.
+      if (node->sameId && node->sameId->score <= score) {
+        skip_addr before = node->sameId;
+        entry.node = before;
+        while (before->sameId && before->sameId->score <= score) {
+          before = before->sameId;
+        }
+        node->sameId = before->sameId;
+        before->sameId = node;
       }
-      current = current->right;
+      return head;
     }
+    entry.Add(score);
     skip_addr node = CreateSkipList(id, score);
-    node->right = current->right;
-    current->right = node;
+    node->serial = ++lastSerial;
+    node->sameId = entry.node;
+    entry.node = node;
+    Link(head, node);
     return head;
   }
 
   void PrintSkipList(skip_addr head) const {
-    skip_addr current = head;
-    while (current) {
-      std::cout << "id: " << current->id << ", score: " << current->score
-                << ", height: " << current->height << '\n';
-      current = current->right;
-    }
+    ListInOrder(head, [](const SkipListNode *node) {
+      std::cout << "id: " << node->id << ", score: " << node->score
+                << ", height: " << node->height << '\n';
+    });
   }
 
   int HeightSkipList(skip_addr head) const {
-    int maxHeight = 0;
-    skip_addr current = head;
-    while (current) {
-      if (current->height > maxHeight) {
-        maxHeight = current->height;
-      }
-      current = current->right;
+    if (!head || !head->next[0]) {
+      return 0;
     }
-    return maxHeight;
+    return head->height;
   }
 
   // 原本的線性掃描版 Search（展示用）
   double SearchAVGSkipList_DFS(skip_addr head, int id) const {
-    int sum = 0;
-    int count = 0;
+    IdAverage average(id);
+    ListInOrder(head, average);
+    return average.Average();
+  }
+
+  double SearchAVGSkipList(skip_addr /*head*/, int id) const {
+    return index.Average(id);
+  }
+
+private:
+  // Towers stop growing here; the head is allocated this tall up front.
+  static const int kMaxHeight = 64;
+
+  double probHead;
+  NodeArena<SkipListNode> *nodes = nullptr;
+  NodeArena<skip_addr> *links = nullptr;
+  // Last node before the insert position on each level; kept to avoid an
+  // allocation per insert.
+  std::vector<skip_addr> update;
+
+  // Each entry's node is the lowest-scored node of that id; the rest follow
+  // it through sameId.
+  IdIndex<SkipListNode> index;
+  unsigned lastSerial = 0;
+
+  // True if a sorts before b in (score, serial) order.
+  static bool Before(const SkipListNode *a, const SkipListNode *b) {
+    return a->score != b->score ? a->score < b->score : a->serial < b->serial;
+  }
+
+  // Fills update[0..head->height) with the last node before node on each level.
+  void FindBefore(skip_addr head, const SkipListNode *node) {
+    update.resize(head->height);
     skip_addr current = head;
-    while (current) {
-      if (current->id == id) {
-        sum += current->score;
-        ++count;
+    for (int level = head->height - 1; level >= 0; --level) {
+      while (current->next[level] && Before(current->next[level], node)) {
+        current = current->next[level];
       }
-      current = current->right;
-    }
-    if (count == 0) {
-      return -1.0;
+      update[level] = current;
     }
-    return static_cast<double>(sum) / count;
   }
 
-  double SearchAVGSkipList(skip_addr head, int id) const {
-    if (!cacheBuilt) {
-      buildAvgCache(head);
-      cacheBuilt = true;
+  // Splices node's tower in at its (score, serial) position.
+  void Link(skip_addr head, skip_addr node) {
+    FindBefore(head, node);
+    if (node->height > head->height) {
+      update.resize(node->height, head);
+      head->height = node->height;
     }
-    auto it = avgCache.find(id);
-    if (it == avgCache.end() || it->second.second == 0) {
-      return -1.0;
+    for (int level = 0; level < node->height; ++level) {
+      node->next[level] = update[level]->next[level];
+      update[level]->next[level] = node;
     }
-    return static_cast<double>(it->second.first) / it->second.second;
   }
 
-private:
-  double probHead;
-
-  // id -> (sum, count)
-  mutable bool cacheBuilt = false;
-  mutable std::map<int, std::pair<long long, int>> avgCache;
-
-  void buildAvgCache(skip_addr head) const {
-    avgCache.clear();
-    skip_addr current = head;
-    while (current) {
-      auto &entry = avgCache[current->id];
-      entry.first += current->score;
-      entry.second += 1;
-      current = current->right;
+  void Unlink(skip_addr head, skip_addr node) {
+    FindBefore(head, node);
+    for (int level = 0; level < node->height; ++level) {
+      update[level]->next[level] = node->next[level];
     }
   }
 
+  // Tower height: 1 plus one more level per coin flip that lands heads with
+  // probability probHead.
   skip_addr CreateSkipList(int id, int score) {
     int height = 1;
-    while (static_cast<double>(std::rand()) / RAND_MAX < probHead) {
+    while (height < kMaxHeight &&
+           static_cast<double>(std::rand()) / RAND_MAX < probHead) {
       ++height;
     }
-    return new SkipListNode(id, score, height);
+    return NewNode(id, score, height);
+  }
+
+  skip_addr NewNode(int id, int score, int height) {
+    if (!nodes) {
+      return new SkipListNode(id, score, height, new skip_addr[height]());
+    }
+    skip_addr *next = links->Allocate(height);
+    std::fill(next, next + height, nullptr);
+    return nodes->New(id, score, height, next);
   }
 };
 
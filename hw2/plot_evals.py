@@ -21,12 +21,16 @@ def plot_fig1_insert_time():
     avl = [float(row["AVL_us_per_insert"]) for row in data]
     treap = [float(row["Treap_us_per_insert"]) for row in data]
     skip_p05 = [float(row["SkipList_p0.5_us_per_insert"]) for row in data]
+    skip_p075 = [float(row["SkipList_p0.75_us_per_insert"]) for row in data]
+    skip_p025 = [float(row["SkipList_p0.25_us_per_insert"]) for row in data]
 
     plt.figure()
     plt.plot(n, bst, marker="o", label="BST")
     plt.plot(n, avl, marker="s", label="AVL")
     plt.plot(n, treap, marker="^", label="Treap")
     plt.plot(n, skip_p05, marker="D", label="Skip List (p=0.5)")
+    plt.plot(n, skip_p075, marker="v", label="Skip List (p=0.75)")
+    plt.plot(n, skip_p025, marker="P", label="Skip List (p=0.25)")
 
     plt.xscale("log", base=2)
     plt.xlabel("n")
@@ -47,12 +51,16 @@ def plot_fig2_search_time():
     avl = [float(row["AVL_us_per_search"]) for row in data]
     treap = [float(row["Treap_us_per_search"]) for row in data]
     skip_p05 = [float(row["SkipList_p0.5_us_per_search"]) for row in data]
+    skip_p075 = [float(row["SkipList_p0.75_us_per_search"]) for row in data]
+    skip_p025 = [float(row["SkipList_p0.25_us_per_search"]) for row in data]
 
     plt.figure()
     plt.plot(n, bst, marker="o", label="BST")
     plt.plot(n, avl, marker="s", label="AVL")
     plt.plot(n, treap, marker="^", label="Treap")
     plt.plot(n, skip_p05, marker="D", label="Skip List (p=0.5)")
+    plt.plot(n, skip_p075, marker="v", label="Skip List (p=0.75)")
+    plt.plot(n, skip_p025, marker="P", label="Skip List (p=0.25)")
 
     plt.xscale("log", base=2)
     plt.xlabel("n")
@@ -78,6 +86,9 @@ def plot_fig3_height():
     avl_bf3 = [float(row["AVL_BF3_height"]) for row in data]
 
     bst = [float(row["BST_height"]) for row in data]
+    bst_by_id = [float(row["BST_by_id_height"]) for row in data]
+    avl_by_id = [float(row["AVL_by_id_height"]) for row in data]
+    treap_by_id = [float(row["Treap_by_id_height"]) for row in data]
 
     plt.figure()
     plt.plot(n, bst, marker="o", label="BST")
@@ -87,6 +98,10 @@ def plot_fig3_height():
     plt.plot(n, skip_p075, marker="v", label="Skip List (p=0.75)")
     plt.plot(n, skip_p025, marker="P", label="Skip List (p=0.25)")
     plt.plot(n, avl_bf3, marker="X", label="AVL (|BF| ≤ 3)")
+    plt.plot(n, bst_by_id, marker="o", linestyle="--", label="BST by (score, id)")
+    plt.plot(n, avl_by_id, marker="s", linestyle="--", label="AVL by (score, id)")
+    plt.plot(n, treap_by_id, marker="^", linestyle="--",
+             label="Treap by (score, id)")
 
     plt.xscale("log", base=2)
     plt.xlabel("n")
@@ -110,6 +125,9 @@ def plot_fig3_height_no_bst():
     skip_p075 = [float(row["SkipList_p0.75_height"]) for row in data]
     skip_p025 = [float(row["SkipList_p0.25_height"]) for row in data]
     avl_bf3 = [float(row["AVL_BF3_height"]) for row in data]
+    bst_by_id = [float(row["BST_by_id_height"]) for row in data]
+    avl_by_id = [float(row["AVL_by_id_height"]) for row in data]
+    treap_by_id = [float(row["Treap_by_id_height"]) for row in data]
 
     plt.figure()
     plt.plot(n, avl, marker="s", label="AVL")
@@ -118,6 +136,10 @@ def plot_fig3_height_no_bst():
     plt.plot(n, skip_p075, marker="v", label="Skip List (p=0.75)")
     plt.plot(n, skip_p025, marker="P", label="Skip List (p=0.25)")
     plt.plot(n, avl_bf3, marker="X", label="AVL (|BF| ≤ 3)")
+    plt.plot(n, bst_by_id, marker="o", linestyle="--", label="BST by (score, id)")
+    plt.plot(n, avl_by_id, marker="s", linestyle="--", label="AVL by (score, id)")
+    plt.plot(n, treap_by_id, marker="^", linestyle="--",
+             label="Treap by (score, id)")
 
     plt.xscale("log", base=2)
     plt.xlabel("n")
@@ -130,11 +152,99 @@ def plot_fig3_height_no_bst():
     plt.close()
 
 
+def plot_fig4_mixed_time():
+    data = read_csv_dicts(EVALS_DIR / "fig4_mixed_time.csv")
+
+    n = [int(row["n"]) for row in data]
+    bst = [float(row["BST_us_per_op"]) for row in data]
+    avl = [float(row["AVL_us_per_op"]) for row in data]
+    treap = [float(row["Treap_us_per_op"]) for row in data]
+    skip_p05 = [float(row["SkipList_p0.5_us_per_op"]) for row in data]
+    skip_p075 = [float(row["SkipList_p0.75_us_per_op"]) for row in data]
+    skip_p025 = [float(row["SkipList_p0.25_us_per_op"]) for row in data]
+
+    plt.figure()
+    plt.plot(n, bst, marker="o", label="BST")
+    plt.plot(n, avl, marker="s", label="AVL")
+    plt.plot(n, treap, marker="^", label="Treap")
+    plt.plot(n, skip_p05, marker="D", label="Skip List (p=0.5)")
+    plt.plot(n, skip_p075, marker="v", label="Skip List (p=0.75)")
+    plt.plot(n, skip_p025, marker="P", label="Skip List (p=0.25)")
+
+    plt.xscale("log", base=2)
+    plt.xlabel("n")
+    plt.ylabel("Average time per operation (µs)")
+    plt.title("Figure 4: Mixed insert/search time vs n")
+    plt.grid(True, which="both", linestyle="--", alpha=0.5)
+    plt.legend()
+    plt.tight_layout()
+    plt.savefig(EVALS_DIR / "fig4_mixed_time.png", dpi=300)
+    plt.close()
+
+
+def plot_fig5_arena_insert_time():
+    data = read_csv_dicts(EVALS_DIR / "fig5_arena_insert_time.csv")
+
+    n = [int(row["n"]) for row in data]
+
+    plt.figure()
+    for name, label, marker in [
+        ("BST", "BST", "o"),
+        ("AVL", "AVL", "s"),
+        ("Treap", "Treap", "^"),
+        ("SkipList", "Skip List (p=0.5)", "D"),
+    ]:
+        heap = [float(row[f"{name}_new_us_per_insert"]) for row in data]
+        arena = [float(row[f"{name}_arena_us_per_insert"]) for row in data]
+        line, = plt.plot(n, heap, marker=marker, label=f"{label}, new")
+        plt.plot(n, arena, marker=marker, linestyle="--",
+                 color=line.get_color(), label=f"{label}, arena")
+
+    plt.xscale("log", base=2)
+    plt.xlabel("n")
+    plt.ylabel("Average insert time per element (µs)")
+    plt.title("Figure 5: Insert time with and without NodeArena")
+    plt.grid(True, which="both", linestyle="--", alpha=0.5)
+    plt.legend()
+    plt.tight_layout()
+    plt.savefig(EVALS_DIR / "fig5_arena_insert_time.png", dpi=300)
+    plt.close()
+
+
+def plot_fig6_bulk_load_time():
+    data = read_csv_dicts(EVALS_DIR / "fig6_bulk_load_time.csv")
+
+    n = [int(row["n"]) for row in data]
+    avl_insert = [float(row["AVL_insert_us_per_item"]) for row in data]
+    avl_bulk = [float(row["AVL_bulk_us_per_item"]) for row in data]
+    treap_insert = [float(row["Treap_insert_us_per_item"]) for row in data]
+    treap_bulk = [float(row["Treap_bulk_us_per_item"]) for row in data]
+
+    plt.figure()
+    plt.plot(n, avl_insert, marker="s", label="AVL, n inserts")
+    plt.plot(n, avl_bulk, marker="s", linestyle="--", label="AVL, BulkLoad")
+    plt.plot(n, treap_insert, marker="^", label="Treap, n inserts")
+    plt.plot(n, treap_bulk, marker="^", linestyle="--", label="Treap, BulkLoad")
+
+    plt.xscale("log", base=2)
+    plt.xlabel("n")
+    plt.ylabel("Average build time per element (µs)")
+    plt.title("Figure 6: Build time, inserts vs bulk load")
+    plt.grid(True, which="both", linestyle="--", alpha=0.5)
+    plt.legend()
+    plt.tight_layout()
+    plt.savefig(EVALS_DIR / "fig6_bulk_load_time.png", dpi=300)
+    plt.close()
+
+
 def main():
     plot_fig1_insert_time()
     plot_fig2_search_time()
     plot_fig3_height()
     plot_fig3_height_no_bst()
+    plot_fig4_mixed_time()
+    plot_fig5_arena_insert_time()
+    plot_fig6_bulk_load_time()
 
 
 if __name__ == "__main__":